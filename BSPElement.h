@@ -2,12 +2,16 @@
 
 #include <iostream>
 #include <fstream>
+#include <algorithm>
+#include <cstring>
 #include <array>
 #include <string>
 #include <vector>
 
 #include "vector.h"
 #include "lumps.h"
+#include "lumpView.h"
+#include "mappedFile.h"
 
 namespace BSP {
     template <typename T>
@@ -17,21 +21,68 @@ namespace BSP {
         virtual ~Element() = default;
 
         virtual void load(std::ifstream& file, LumpData& lumpData) {
+            mapped = LumpView<T>();
+
             int numberOfElements = static_cast<int>(std::ceil(static_cast<float>(lumpData.length) / sizeof(T)));
             elements.resize(numberOfElements);
 
             file.seekg(lumpData.offset, std::ios::beg);
             file.read(reinterpret_cast<char*>(elements.data()), lumpData.length);
 
+            if (isTranscoded()) {
+                transcode(elements.data(), elements.data(), lumpData.length / sizeof(T));
+            }
+
             //validate();
         }
 
+        // Zero-copy load: the elements are read straight from the mapping.
+        // Lumps stored in Quake axes are converted into elements instead, in the same pass as the copy.
+        virtual void load(const MappedFile& file, LumpData& lumpData) {
+            if (!isTranscoded()) {
+                elements.clear();
+                mapped = file.view<T>(lumpData);
+                return;
+            }
+
+            mapped = LumpView<T>();
+
+            if (!file.contains(lumpData)) {
+                elements.clear();
+                return;
+            }
+
+            int numberOfElements = static_cast<int>(std::ceil(static_cast<float>(lumpData.length) / sizeof(T)));
+            elements.resize(numberOfElements);
+
+            size_t wholeElements = lumpData.length / sizeof(T);
+            const T* source = reinterpret_cast<const T*>(file.data() + lumpData.offset);
+            transcode(source, elements.data(), wholeElements);
+
+            // A truncated last record is copied as is, like the streamed load does
+            std::memcpy(reinterpret_cast<unsigned char*>(elements.data() + wholeElements),
+                reinterpret_cast<const unsigned char*>(source + wholeElements), lumpData.length - wholeElements * sizeof(T));
+        }
+
         virtual void displayData() const = 0;
         virtual void validate() = 0;
 
-        size_t size() const { return elements.size(); }
-        const std::vector<T>& getData() const { return elements; }
+        size_t size() const { return getData().size(); }
+
+        LumpView<T> getData() const {
+            if (mapped.data() != nullptr) {
+                return mapped;
+            }
+            return LumpView<T>(elements.data(), elements.size());
+        }
+
     protected:
-        std::vector<T> elements;
+        std::vector<T> elements;    // Owned copy, used by streamed loads and modified lumps
+        LumpView<T> mapped;         // View into a MappedFile, used by zero-copy loads
+
+        // Spatial lumps return true and convert their records from Quake to engine axes in transcode().
+        // source and destination are the same array for streamed loads.
+        virtual bool isTranscoded() const { return false; }
+        virtual void transcode(const T* /*source*/, T* /*destination*/, size_t /*count*/) {}
     };
-}
\ No newline at end of file
+}
@@ -5,7 +5,9 @@
 
 #include "vector.h"
 #include "GL_Utils.h"
+#include "debugDraw.h"
 
-void drawAxes(GLuint shaderProgram);
-void drawTriangle(GLuint shaderProgram, Vec3f v1, Vec3f v2, Vec3f v3);
-void drawSphere(GLuint shaderProgram, float radius, Vec3f p);
\ No newline at end of file
+// Shapes are queued in debugDraw and drawn by its next flush()
+void drawAxes(DebugDraw& debugDraw);
+void drawTriangle(DebugDraw& debugDraw, Vec3f v1, Vec3f v2, Vec3f v3);
+void drawSphere(DebugDraw& debugDraw, float radius, Vec3f p);
\ No newline at end of file
@@ -46,4 +46,55 @@ void checkGLError(const std::string& label) {
     if (error != GL_NO_ERROR) {
         std::cerr << label << " - GL Error: " << error << std::endl;
     }
+}
+
+GLuint compileShader(GLenum type, const char* source, const std::string& name) {
+    GLuint shader = glCreateShader(type);
+    /*
+    * glShadersource: loads the GLSL code from the strings into the empty shader objects
+    *
+    * shader: the shader object in which to store the shader
+    * 1: number of strings in the shader source code
+    * source: an array of pointers to strings containing the source code
+    */
+    glShaderSource(shader, 1, &source, NULL);
+    glCompileShader(shader);
+
+    /*
+    * glGetshaderiv: retrieves the compile status of the specified shader.
+    * The GL_COMPILE_STATUS parameter tells the function to get the compilation
+    * status. The result is stored in the success variable. If the compilation
+    * was successful, success will be set to a non-zero value (usually GL_TRUE),
+    * otherwise, it will be set to zero (usually GL_FALSE).
+    */
+    int success;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        //retrieves the error log. 512 is the max length of log message stored in infolog
+        char infoLog[512];
+        glGetShaderInfoLog(shader, 512, NULL, infoLog);
+        std::cout << name << " compilation failed: " << infoLog << std::endl;
+    }
+
+    return shader;
+}
+
+GLuint linkProgram(GLuint vertexShader, GLuint fragmentShader, const std::string& name) {
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vertexShader);
+    glAttachShader(program, fragmentShader);
+    glLinkProgram(program);
+
+    int success;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success) {
+        char infoLog[512];
+        glGetProgramInfoLog(program, 512, NULL, infoLog);
+        std::cout << name << " linking failed: " << infoLog << std::endl;
+    }
+
+    glDeleteShader(vertexShader);
+    glDeleteShader(fragmentShader);
+
+    return program;
 }
\ No newline at end of file
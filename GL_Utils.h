@@ -15,4 +15,10 @@ void setupOpenGL();
 //called whenever the window is resized
 void framebufferSizeCallback(GLFWwindow* window, int width, int height);
 
-void checkGLError(const std::string& label);
\ No newline at end of file
+void checkGLError(const std::string& label);
+
+// Failures are logged with the name, "<name> compilation failed: <log>"
+GLuint compileShader(GLenum type, const char* source, const std::string& name);
+
+// Links the two shaders into a program and deletes them, failures are logged like compileShader()
+GLuint linkProgram(GLuint vertexShader, GLuint fragmentShader, const std::string& name);
\ No newline at end of file
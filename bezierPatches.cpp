@@ -1,106 +1,28 @@
+#include <algorithm>
+
+#include "patchTessellator.h"     // Brings glad, which has to come before the GL headers of vertices.h
 #include "bezierPatches.h"
 
 // Mtodo de tesselao
 void QuadraticPatch::tesselate(int tessellationLevel) {
-    vertices.resize((tessellationLevel + 1) * (tessellationLevel + 1));
+    BSP::PatchTessellator tessellator(tessellationLevel);
+    tessellationLevel = tessellator.getLevel();
 
-    // Cada quadrado tem 2 tringulos e cada tringulo tem 3 vrtices
-    int total_indices = tessellationLevel * tessellationLevel * 2 * 3;
-    indices.getValues().resize(total_indices);
+    vertices.resize(tessellator.getVertexCount());
+    indices.getValues().resize(tessellator.getIndexCount());
 
     trianglesPerRow.resize(tessellationLevel);
     rowIndices.getValues().resize(tessellationLevel);
 
-    std::vector<Vec3f> tempPos(3);  // array temporrio para armazenar os pontos intermedirios
-    std::vector<Vec4f> tempColor(3);  // array temporrio para armazenar os pontos intermedirios
-
-    for (int uIdx = 0; uIdx <= tessellationLevel; uIdx++) {
-        float u = (float)uIdx / tessellationLevel;
-        float B0_u = ((1.0f - u) * (1.0f - u));
-        float B1_u = ((1.0f - u) * u * 2);
-        float B2_u = u * u;
-
-        Vec3f auxPosition = controlPoints[0].getPosition() * B0_u 
-            + controlPoints[3].getPosition() * B1_u
-            + controlPoints[6].getPosition() * B2_u;
-
-        // Interpolao de cores para uIdx
-        Vec4f auxColor;
-        for (int i = 0; i < 4; i++) {
-            auxColor[i] = static_cast<float>(controlPoints[0].getColor()[i]) * B0_u
-                + static_cast<float>(controlPoints[3].getColor()[i]) * B1_u
-                + static_cast<float>(controlPoints[6].getColor()[i]) * B2_u;
-        }
-
-        vertices[uIdx].setPosition(auxPosition);
-        vertices[uIdx].setColor(auxColor);
-    }
+    const BSP::Vertex* points[9];
+    for (int i = 0; i < 9; i++)
+        points[i] = &controlPoints[i];
 
-    for (int vIdx = 1; vIdx <= tessellationLevel; vIdx++) {
-        float v = (float)vIdx / tessellationLevel;
-        float B0_v = ((1.0f - v) * (1.0f - v));
-        float B1_v = ((1.0f - v) * v * 2);
-        float B2_v = v * v;
-
-        //position
-        tempPos[0] = controlPoints[0].getPosition() * B0_v
-            + controlPoints[1].getPosition() * B1_v
-            + controlPoints[2].getPosition() * B2_v;
-
-        tempPos[1] = controlPoints[3].getPosition() * B0_v
-            + controlPoints[4].getPosition() * B1_v
-            + controlPoints[5].getPosition() * B2_v;
-
-        tempPos[2] = controlPoints[6].getPosition() * B0_v
-            + controlPoints[7].getPosition() * B1_v
-            + controlPoints[8].getPosition() * B2_v;
-
-        // Interpolao de cores para vIdx (posies 0, 3, 6)
-        for (int i = 0; i < 4; i++) {
-            tempColor[0][i] = static_cast<float>(controlPoints[0].getColor()[i]) * B0_v
-                + static_cast<float>(controlPoints[1].getColor()[i]) * B1_v
-                + static_cast<float>(controlPoints[2].getColor()[i]) * B2_v;
-
-            tempColor[1][i] = static_cast<float>(controlPoints[3].getColor()[i]) * B0_v
-                + static_cast<float>(controlPoints[4].getColor()[i]) * B1_v
-                + static_cast<float>(controlPoints[5].getColor()[i]) * B2_v;
-
-            tempColor[2][i] = static_cast<float>(controlPoints[6].getColor()[i]) * B0_v
-                + static_cast<float>(controlPoints[7].getColor()[i]) * B1_v
-                + static_cast<float>(controlPoints[8].getColor()[i]) * B2_v;
-        }
-
-        for (int uIdx = 0; uIdx <= tessellationLevel; uIdx++) {
-            float u = (float)uIdx / tessellationLevel;
-            float B0_u = ((1.0f - u) * (1.0f - u));
-            float B1_u = ((1.0f - u) * u * 2);
-            float B2_u = u * u;
-
-            Vec3f finalPosition = tempPos[0] * B0_u + tempPos[1] * B1_u + tempPos[2] * B2_u;
-            vertices[vIdx * (tessellationLevel + 1) + uIdx].setPosition(finalPosition);
-
-            Vec4f finalColor;
-            for (int i = 0; i < 4; i++)
-                finalColor[i] = tempColor[0][i] * B0_u + tempColor[1][i] * B1_u + tempColor[2][i] * B2_u;
-            vertices[vIdx * (tessellationLevel + 1) + uIdx].setColor(finalColor);
-        }
-    }
+    tessellator.tessellate(points, vertices.data());
 
-    std::vector<int>& ind_values = indices.getValues();
-    size_t index = 0;
-    for (int row = 0; row < tessellationLevel; ++row) {
-        for (int col = 0; col < tessellationLevel; ++col) {
-            // Primeiro tringulo
-            ind_values[index++] = row * (tessellationLevel + 1) + col;
-            ind_values[index++] = (row + 1) * (tessellationLevel + 1) + col;
-            ind_values[index++] = (row + 1) * (tessellationLevel + 1) + col + 1;
-
-            // Segundo tringulo
-            ind_values[index++] = row * (tessellationLevel + 1) + col;
-            ind_values[index++] = (row + 1) * (tessellationLevel + 1) + col + 1;
-            ind_values[index++] = row * (tessellationLevel + 1) + col + 1;
-        }
-    }
+    std::vector<GLuint> gridIndices(tessellator.getIndexCount());
+    tessellator.writeIndices(0, gridIndices.data());
+    std::copy(gridIndices.begin(), gridIndices.end(), indices.getValues().begin());
 }
 
 void QuadraticPatch::displayData() const {
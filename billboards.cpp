@@ -0,0 +1,150 @@
+#include <algorithm>
+#include <cstddef>
+
+#include "billboards.h"
+#include "glStateCache.h"
+#include "cameraUniforms.h"
+
+namespace BSP {
+    // The corner goes along the camera's right and up axes, taken from the rows of the view rotation
+    static const char* vertexShaderSource = "#version 330 core\n"
+        CAMERA_UNIFORM_BLOCK
+        "layout (location = 0) in vec2 aCorner;\n"
+        "layout (location = 1) in vec3 aOrigin;\n"
+        "layout (location = 2) in float aSize;\n"
+        "layout (location = 3) in vec4 aColor;\n"
+        "out vec4 color;\n"
+        "out vec2 corner;\n"
+        "void main()\n"
+        "{\n"
+        "   vec3 right = vec3(view[0][0], view[1][0], view[2][0]);\n"
+        "   vec3 up = vec3(view[0][1], view[1][1], view[2][1]);\n"
+        "   vec3 position = aOrigin + (right * aCorner.x + up * aCorner.y) * aSize;\n"
+        "   gl_Position = viewProjection * vec4(position, 1.0);\n"
+        "   color = aColor;\n"
+        "   corner = aCorner;\n"
+        "}\0";
+
+    // Round glow, fading out towards the edge of the quad
+    static const char* fragmentShaderSource = "#version 330 core\n"
+        "in vec4 color;\n"
+        "in vec2 corner;\n"
+        "out vec4 FragColor;\n"
+        "void main()\n"
+        "{\n"
+        "   float falloff = max(0.0, 1.0 - dot(corner, corner));\n"
+        "   FragColor = vec4(color.rgb * falloff, 1.0);\n"
+        "}\n\0";
+
+    Billboards::~Billboards() {
+        // Only uploaded billboards own GL objects, headless loads never touch GL here
+        if (vao == 0)
+            return;
+
+        glDeleteVertexArrays(1, &vao);
+        glDeleteBuffers(1, &quadVBO);
+        glDeleteBuffers(1, &instanceVBO);
+        GLStateCache::shared().forgetProgram(program);
+        glDeleteProgram(program);
+    }
+
+    void Billboards::build(const Faces& faces, float size) {
+        instances.clear();
+
+        for (const Face& face : faces.getData()) {
+            if (face.getType() != FACE_BBOARD)
+                continue;
+
+            // The flare color is stored as floats in [0, 1] in the first lightmap vector
+            Instance instance;
+            Vec3f origin = face.getLightMapPos();
+            Vec3f color = face.getLightMapVecs()[0];
+
+            for (int i = 0; i < 3; i++) {
+                instance.position[i] = origin[i];
+                instance.color[i] = static_cast<unsigned char>(std::min(1.0f, std::max(0.0f, color[i])) * 255.0f + 0.5f);
+            }
+            instance.color[3] = 255;
+            instance.size = size;
+
+            instances.push_back(instance);
+        }
+    }
+
+    void Billboards::upload() {
+        // A reload keeps the quad and the program, the new instances replace the old ones
+        if (vao != 0) {
+            glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+            glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(Instance), instances.data(), GL_STATIC_DRAW);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            uploadedInstances = instances.size();
+
+            checkGLError("Billboards upload");
+            return;
+        }
+
+        if (instances.empty())
+            return;
+
+        // Triangle strip over the unit quad
+        const float corners[] = { -1.0f, -1.0f, 1.0f, -1.0f, -1.0f, 1.0f, 1.0f, 1.0f };
+
+        glGenVertexArrays(1, &vao);
+        glBindVertexArray(vao);
+
+        glGenBuffers(1, &quadVBO);
+        glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(0);
+
+        glGenBuffers(1, &instanceVBO);
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(Instance), instances.data(), GL_STATIC_DRAW);
+
+        // One value per instance instead of per vertex
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)offsetof(Instance, position));
+        glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)offsetof(Instance, size));
+        glVertexAttribPointer(3, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Instance), (void*)offsetof(Instance, color));
+        for (GLuint location = 1; location <= 3; location++) {
+            glEnableVertexAttribArray(location);
+            glVertexAttribDivisor(location, 1);
+        }
+
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        uploadedInstances = instances.size();
+
+        GLuint vertexShader = compileShader(GL_VERTEX_SHADER, vertexShaderSource, "Billboard vertex shader");
+        GLuint fragmentShader = compileShader(GL_FRAGMENT_SHADER, fragmentShaderSource, "Billboard fragment shader");
+
+        program = linkProgram(vertexShader, fragmentShader, "Billboard shader program");
+
+        CameraUniforms::bindProgram(program);
+
+        checkGLError("Billboards upload");
+    }
+
+    int Billboards::draw() const {
+        if (vao == 0 || uploadedInstances == 0)
+            return 0;
+
+        GLStateCache& state = GLStateCache::shared();
+        state.useProgram(program);
+
+        // Glows add up and never hide what is behind them
+        state.setCapability(GL_BLEND, true);
+        state.blendFunc(GL_ONE, GL_ONE);
+        state.depthMask(false);
+
+        state.bindVertexArray(vao);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(uploadedInstances));
+        state.bindVertexArray(0);
+
+        state.depthMask(true);
+        state.setCapability(GL_BLEND, false);
+        state.useProgram(0);
+
+        return 1;
+    }
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vector>
+
+#include "GL_Utils.h"
+#include "faces.h"
+
+namespace BSP {
+    /*
+    Flares and the other FACE_BBOARD faces. Each one is an instance with its origin, size and color;
+    a shared unit quad is expanded towards the camera in the vertex shader, so the whole set is a
+    single instanced draw and no quad is built on the CPU.
+    */
+    class Billboards {
+    public:
+        // Per-instance data, 20 bytes, in the layout of the instance buffer
+        struct Instance {
+            float position[3];          // Engine (Y-up) axes
+            float size;                 // Half the width of the quad, in world units
+            unsigned char color[4];     // RGBA
+        };
+
+        Billboards() = default;
+        ~Billboards();
+
+        Billboards(const Billboards&) = delete;
+        Billboards& operator=(const Billboards&) = delete;
+
+        // Collect the instances from the faces lump, no GL calls (safe on the loader thread)
+        void build(const Faces& faces, float size);
+
+        // Create the quad, the instance buffer and the shader program. Once they exist, only the
+        // instance buffer is filled again, with the instances of the last build().
+        void upload();
+
+        // Draw every instance with the camera of the CameraUniforms block.
+        // Leaves no program or VAO bound and returns the number of GL draw calls made (0 or 1).
+        // State changes go through GLStateCache.
+        int draw() const;
+
+        const std::vector<Instance>& getInstances() const { return instances; }
+        size_t size() const { return instances.size(); }
+
+    private:
+        std::vector<Instance> instances;
+        GLuint vao = 0;
+        GLuint quadVBO = 0;
+        GLuint instanceVBO = 0;
+        GLuint program = 0;
+        size_t uploadedInstances = 0;   // In instanceVBO, build() may already hold the next map's
+    };
+}
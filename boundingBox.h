@@ -0,0 +1,49 @@
+#pragma once
+
+#include <algorithm>
+
+#include "vector.h"
+#include "matrix.h"
+
+namespace BSP {
+    // Axis aligned box used to cull models, leaves and anything else with bounds
+    struct BoundingBox {
+        Vec3f min;
+        Vec3f max;
+
+        Vec3f corner(int index) const {
+            return Vec3f(index & 1 ? max.x() : min.x(),
+                index & 2 ? max.y() : min.y(),
+                index & 4 ? max.z() : min.z());
+        }
+
+        // True when the box is completely outside one clip plane of modelViewProjection
+        // (row-major, column vectors, same convention as the camera matrices)
+        bool isOutside(const Mat4<float>& modelViewProjection) const {
+            const float* m = modelViewProjection.getData();
+
+            // One bit per clip plane a corner is outside of, the box is culled when all corners share one
+            int sharedOutside = 0x3F;
+            for (int i = 0; i < 8 && sharedOutside != 0; i++) {
+                Vec3f p = corner(i);
+
+                float x = m[0] * p.x() + m[1] * p.y() + m[2] * p.z() + m[3];
+                float y = m[4] * p.x() + m[5] * p.y() + m[6] * p.z() + m[7];
+                float z = m[8] * p.x() + m[9] * p.y() + m[10] * p.z() + m[11];
+                float w = m[12] * p.x() + m[13] * p.y() + m[14] * p.z() + m[15];
+
+                int outside = 0;
+                if (x < -w) outside |= 1;
+                if (x > w) outside |= 2;
+                if (y < -w) outside |= 4;
+                if (y > w) outside |= 8;
+                if (z < -w) outside |= 16;
+                if (z > w) outside |= 32;
+
+                sharedOutside &= outside;
+            }
+
+            return sharedOutside != 0;
+        }
+    };
+}
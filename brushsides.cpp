@@ -3,7 +3,7 @@
 
 namespace BSP {
     void BrushSides::validate() {
-        for (const auto& brushSide : elements) {
+        for (const auto& brushSide : getData()) {
             // Validate brush side data here
             // For example, you can check if the planeIndex or textureID are valid
         }
@@ -12,7 +12,7 @@ namespace BSP {
     void BrushSides::displayData() const {
         std::cout << "Displaying BrushSide Data:" << std::endl;
         int count = 1;
-        for (const auto& brushSide : elements) {
+        for (const auto& brushSide : getData()) {
             std::cout << "BrushSide " << count << ": " << std::endl;
             std::cout << "  Plane Index: " << brushSide.getPlaneIndex() << std::endl;
             std::cout << "  Texture ID: " << brushSide.getTextureID() << std::endl;
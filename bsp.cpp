@@ -1,13 +1,38 @@
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <cmath>
+#include <cstring>
 #include <limits>
 
 #include "bsp.h"
 #include "utils.h"
+#include "threadPool.h"
+#include "glStateCache.h"
 #include "BasicShapes.h"
+#include "patchTessellator.h"
 
 //https://github.com/magnusgrander/SDL2_Quake3loader/blob/main/Quake3Bsp.cpp
 
 namespace BSP {
+	// Frames between two occlusion queries of a leaf that is visible
+	static const unsigned int VISIBLE_QUERY_INTERVAL = 4;
+
+	// Occlusion boxes are grown a little so faces lying on the bounds are not hidden by z-fighting, and
+	// boxes the camera is about to enter are taken as visible: the near plane would clip them open
+	static const float OCCLUSION_BOX_PADDING = 1.0f;
+	static const float OCCLUSION_CAMERA_MARGIN = 16.0f;
+
+	// Bounds of a node or leaf, grown for the occlusion tests
+	static BoundingBox occlusionBounds(const Vec3i& min, const Vec3i& max) {
+		BoundingBox bounds;
+		for (int i = 0; i < 3; i++) {
+			bounds.min[i] = min[i] - OCCLUSION_BOX_PADDING;
+			bounds.max[i] = max[i] + OCCLUSION_BOX_PADDING;
+		}
+		return bounds;
+	}
+
 	Loader::Loader()
 	{
 		header = { 0 };
@@ -20,22 +45,166 @@ namespace BSP {
 
 	Loader::~Loader()
 	{
-		// Delete the unique VAO
-		glDeleteVertexArrays(1, &faceVAO);
+		// A background load still owns the loader, wait for it before tearing anything down
+		if (loadThread.joinable())
+			loadThread.join();
 
-		// Se voc tiver um VBO e EBO globais, tambm pode delet-los aqui.
-		glDeleteBuffers(1, &faceVBO);
+		// Headless or failed loads never created any GL object (and may not even have a GL context)
+		if (faceVAO == 0)
+			return;
 
-		// Delete the unique VAO
-		glDeleteVertexArrays(1, &faceVAO);
+		deleteGeometryBuffers();
 
-		glDeleteBuffers(1, &patchVBO);
-		glDeleteVertexArrays(1, &patchVAO);
-		glDeleteBuffers(1, &patchVBO);
-		glDeleteBuffers(1, &patchEBO);
+		if (fragmentQueries[0] != 0)
+			glDeleteQueries(2, fragmentQueries);
 	}
 
 	bool Loader::load(const std::string& filename)
+	{
+		if (!prepare(filename))
+		{
+			loadState = LoadState::Failed;
+			return false;
+		}
+
+		// Inicialize as faces, criando VBOs e VAOs
+		if (!headless)
+		{
+			createGeometryBuffers(true);
+			releasePendingGeometry();
+			lightmaps.upload();
+			billboards.upload();
+
+			// The uploads bound buffers, VAOs and textures directly
+			GLStateCache::shared().invalidate();
+		}
+
+		setLoadProgress(1.0f, "Done");
+		loadState = LoadState::Ready;
+
+		return true;
+	}
+
+	bool Loader::loadAsync(const std::string& filename)
+	{
+		if (loadState == LoadState::Loading || loadState == LoadState::Uploading)
+		{
+			std::cout << "A BSP file is already being loaded!" << std::endl;
+			return false;
+		}
+
+		if (loadThread.joinable())
+			loadThread.join();
+
+		loadState = LoadState::Loading;
+		setLoadProgress(0.0f, "Starting");
+
+		// File I/O, parsing and tessellation run on the worker, GL upload stays on the render thread
+		loadThread = std::thread([this, filename]() {
+			if (!prepare(filename))
+				loadState = LoadState::Failed;
+			else
+				loadState = headless ? LoadState::Ready : LoadState::Uploading;
+		});
+
+		return true;
+	}
+
+	bool Loader::updateAsyncLoad(size_t uploadBudgetBytes)
+	{
+		LoadState state = loadState;
+
+		if (state == LoadState::Ready)
+			return true;
+
+		if (state == LoadState::Idle || state == LoadState::Loading)
+			return false;
+
+		// The worker is done (Uploading or Failed), it only has to be joined once
+		if (loadThread.joinable())
+			loadThread.join();
+
+		if (state == LoadState::Failed)
+			return false;
+
+		// The uploads bind buffers, VAOs and textures directly
+		GLStateCache::shared().invalidate();
+
+		if (!pendingUpload.buffersCreated)
+			createGeometryBuffers(false);
+
+		if (!uploadGeometrySlice(uploadBudgetBytes))
+			return false;
+
+		releasePendingGeometry();
+		lightmaps.upload();
+		billboards.upload();
+
+		setLoadProgress(1.0f, "Done");
+		loadState = LoadState::Ready;
+
+		return true;
+	}
+
+	void Loader::setLoadProgress(float progress, const char* stage)
+	{
+		loadProgress = progress;
+		loadStage = stage;
+	}
+
+	// Tasks finishing on several threads store their counts out of order, a later store may be the smaller one
+	void Loader::advanceLoadProgress(float progress, const char* stage)
+	{
+		float current = loadProgress;
+		while (current < progress && !loadProgress.compare_exchange_weak(current, progress)) {
+			// A failed exchange reloaded current, retry while it is still behind
+		}
+		loadStage = stage;
+	}
+
+	bool Loader::prepare(const std::string& filename)
+	{
+		setLoadProgress(0.0f, "Reading header");
+
+		bool headerRead = (loadMode == LoadMode::MemoryMapped) ?
+			readMappedHeader(filename) : readHeader(filename);
+
+		if (!headerRead)
+			return false;
+
+		this->filename = filename;
+
+		setLoadProgress(0.05f, "Decoding lumps");
+		loadLumps();
+		initializeSubtreeLeaves();
+
+		// Pure CPU work, headless loads have the faces for it when software occlusion was asked for
+		if (!headless || softwareOcclusion)
+			occlusionRasterizer.build(faces, vertices, indices, textures, models);
+
+		if (headless) {
+			setLoadProgress(1.0f, "Done");
+			return true;
+		}
+
+		initializeLightGrid();
+		initializeFaceCenters();
+		initializeUnreferencedFaces();
+		billboards.build(faces, billboardSize);
+
+		setLoadProgress(0.3f, "Building geometry");
+		initializeGeometry();
+
+		// The index lists only depend on the tessellation level, they are not part of the cooked cache
+		patchLod.build(faces, vertices, tesselationLevel);
+		pendingUpload.patchLodIndexData = LumpView<GLuint>(patchLod.getIndices().data(), patchLod.getIndices().size());
+
+		setLoadProgress(0.8f, "Uploading geometry");
+
+		return true;
+	}
+
+	bool Loader::readHeader(const std::string& filename)
 	{
 		std::ifstream file;
 		file.open(filename, std::ios::binary);
@@ -55,9 +224,8 @@ namespace BSP {
 		file.read(reinterpret_cast<char*>(&header), sizeof(Header));
 
 		// Check if the header ID and version are correct
-		if (strncmp(header.strID, "IBSP", 4) != 0 || header.version != 0x2e)
+		if (!isHeaderValid())
 		{
-			std::cout << "Invalid BSP header or unsupported version!" << std::endl;
 			file.close();
 			return false;
 		}
@@ -66,143 +234,819 @@ namespace BSP {
 		file.read(reinterpret_cast<char*>(lumps),
 			static_cast<int>(LUMPS::MAXLUMPS) * sizeof(LumpData));
 
-		loadLumps(file);
+		file.close();
 
-		// Inicialize as faces, criando VBOs e VAOs
-		initializeFaces();
-		initializeBezierPatches();
+		return true;
+	}
 
-		file.close();
+	bool Loader::readMappedHeader(const std::string& filename)
+	{
+		// The whole file is mapped once, lumps that need no conversion are viewed in place
+		if (!mappedFile.open(filename))
+		{
+			std::cout << "Could not find or open BSP file: " << filename << std::endl;
+			return false;
+		}
+		else
+		{
+			std::cout << "File '" << filename << "' mapped successfully!" << std::endl;
+		}
+
+		if (mappedFile.size() < sizeof(Header) + sizeof(lumps))
+		{
+			std::cout << "BSP file is too small to hold its header!" << std::endl;
+			mappedFile.close();
+			return false;
+		}
+
+		//BSP HEADER
+		std::memcpy(&header, mappedFile.data(), sizeof(Header));
+
+		if (!isHeaderValid())
+		{
+			mappedFile.close();
+			return false;
+		}
+
+		//BSP LUMPS
+		std::memcpy(lumps, mappedFile.data() + sizeof(Header), sizeof(lumps));
 
 		return true;
 	}
 
-	void Loader::loadLumps(std::ifstream& file)
+	bool Loader::isHeaderValid() const
 	{
-		// Read the vertex data
-		vertices.load(file, lumps[static_cast<int>(LUMPS::VERTICES)]);
+		if (strncmp(header.strID, "IBSP", 4) != 0 || header.version != 0x2e)
+		{
+			std::cout << "Invalid BSP header or unsupported version!" << std::endl;
+			return false;
+		}
+
+		return true;
+	}
 
-		//vertices.displayData();
-		//vertices.validate();
-		//std::cin.get();
+	void Loader::loadLumps()
+	{
+		if (loadMode == LoadMode::MemoryMapped)
+		{
+			// The mapping is read-only, every task can share it
+			decodeLumps([this]() -> const MappedFile& { return mappedFile; });
+		}
+		else
+		{
+			// std::ifstream can't be shared between threads, so every task opens its own stream
+			decodeLumps([this]() { return std::ifstream(filename, std::ios::binary); });
+		}
+	}
+
+	// Every lump is decoded (read, swizzled and optionally validated) as an independent task.
+	// The tasks touch disjoint members, so they only have to be joined before the faces are built.
+	template <typename OpenSource>
+	void Loader::decodeLumps(OpenSource openSource)
+	{
+		auto element = [this, &openSource](auto& target, LUMPS lump) {
+			return [this, &openSource, &target, lump]() {
+				auto&& source = openSource();
+				target.load(source, lumps[static_cast<int>(lump)]);
+
+				if (validateLumps)
+					target.validate();
+			};
+		};
+
+		auto indexed = [this, &openSource](IndexedData& target, LUMPS lump) {
+			return [this, &openSource, &target, lump]() {
+				auto&& source = openSource();
+				target.load(source,
+					lumps[static_cast<int>(lump)].length,
+					lumps[static_cast<int>(lump)].offset);
+			};
+		};
+
+		// Collision and visibility data, needed by every load
+		std::vector<std::function<void()>> tasks = {
+			element(textures, LUMPS::TEXTURES),
+			element(nodes, LUMPS::NODES),
+			element(leaves, LUMPS::LEAVES),
+			element(planes, LUMPS::PLANES),
+			element(pvs, LUMPS::PVS),
+			element(brushes, LUMPS::BRUSHES),
+			element(brushsides, LUMPS::BRUSH_SIDES),
+			element(entities, LUMPS::ENTITIES),
+			element(models, LUMPS::MODELS),
+			indexed(leafBrushes, LUMPS::LEAF_BRUSHES)
+		};
+
+		// Render data, skipped by headless loads. The occluders of the software occlusion are faces.
+		if (!headless || softwareOcclusion) {
+			tasks.push_back(element(vertices, LUMPS::VERTICES));
+			tasks.push_back(element(faces, LUMPS::FACES));
+			tasks.push_back(indexed(indices, LUMPS::INDICES));
+		}
+		if (!headless) {
+			tasks.push_back(element(lightmaps, LUMPS::LIGHTMAPS));
+			tasks.push_back(element(lightVolumes, LUMPS::LIGHTVOLUMES));
+			tasks.push_back(indexed(leafFaces, LUMPS::LEAF_FACES));
+		}
+
+		std::atomic<int> decoded(0);
+
+		ThreadPool::shared().parallelFor(static_cast<int>(tasks.size()),
+			[this, &tasks, &decoded](int taskIndex) {
+				tasks[taskIndex]();
+				advanceLoadProgress(0.05f + 0.25f * ++decoded / tasks.size(), "Decoding lumps");
+			});
+	}
+
+	void Loader::displayHeaderData(Header& header) {
+		std::cout << "BSP header data" << std::endl;
+		std::cout << header.strID << std::endl;
+		std::cout << header.version << std::endl;
+	}
+
+	void Loader::displayLumpData(LumpData(&lumps)[static_cast<int>(LUMPS::MAXLUMPS)]) {
+		for (int i = 0; i < static_cast<int>(LUMPS::MAXLUMPS); i++) {
+			std::cout << "LUMP: " << i << std::endl;
+			std::cout << "Offset: " << lumps[i].offset << std::endl;
+			std::cout << "Length: " << lumps[i].length << std::endl;
+		}
+	}
 
-		// Read the face data
-		faces.load(file, lumps[static_cast<int>(LUMPS::FACES)]);
+	void Loader::drawLevel(const Vec3<float>& vPos, GLuint shaderProgram) {
+		// Nothing to draw until the GL buffers are complete, and never anything in headless mode
+		if (headless || loadState != LoadState::Ready)
+			return;
 
-		//faces.displayData();
-		//faces.validate();
-		//std::cin.get();
+		this->shaderProgram = shaderProgram;
+		cameraPosition = vPos;
+		renderQueue.clear();
+		patchTriangles = 0;
+
+		// Row 1 of the view projection is the camera's up axis scaled by the projection, its length
+		// is the height of the view at a distance of 1 over 2
+		patchLodScale = 0.0f;
+		if (patchLodEnabled && cullModels && patchLod.isBuilt() && patchLodError > 0.0f) {
+			const float* m = viewProjection.getData();
+			float scale = std::sqrt(m[4] * m[4] + m[5] * m[5] + m[6] * m[6]);
+			patchLodScale = scale * viewportHeight * 0.5f / patchLodError;
+		}
 
-		// Read texture data
-		textures.load(file, lumps[static_cast<int>(LUMPS::TEXTURES)]);
+		bool occlusion = occlusionCulling && nodes.size() > 0;
+		occludedLeaves = 0;
+		occlusionQueryCount = 0;
+		if (occlusion) {
+			if (!occlusionQueries.isCreated())
+				initializeOcclusion();
+
+			// A hidden node that came back into view has stale answers below it, everything there is drawn
+			// again until its own queries catch up
+			occlusionQueries.collectResults();
+			for (int object : occlusionQueries.getRevealed()) {
+				if (object < static_cast<int>(nodes.size()))
+					revealSubtree(object);
+			}
 
-		//textures.displayData();
-		//textures.validate();
-		//std::cin.get();
+			occlusionFrame++;
+			walkedNodes.clear();
+		}
 
-		// Read lightmap data
-		lightmaps.load(file, lumps[static_cast<int>(LUMPS::LIGHTMAPS)]);
+		// The occluders are drawn with the view projection of the frame, none was given yet without it
+		bool software = softwareOcclusion && cullModels && nodes.size() > 0 && occlusionRasterizer.getOccluderCount() > 0;
+		softwareCulledLeaves = 0;
+		softwareCulledPatches = 0;
+		if (software)
+			occlusionRasterizer.render(viewProjection);
+
+		// Model 0 is the world, its faces never move. Maps without a models lump draw every face.
+		// The walk goes through the world's tree from the camera position as is.
+		LumpView<Model> allModels = models.getData();
+		if (allModels.empty())
+			queueFaces(0, static_cast<int>(faces.size()), Mat4<float>());
+		else if ((frontToBack || occlusion || software) && nodes.size() > 0)
+			queueWorldFrontToBack(Mat4<float>(), occlusion, software);
+		else
+			queueModel(0, Mat4<float>());
 
-		//lightmaps.displayData();
-		//lightmaps.validate();
-		//std::cin.get();
+		culledModels = 0;
+		for (int modelIndex = 1; modelIndex < static_cast<int>(allModels.size()); modelIndex++) {
+			const Mat4<float>& transform = modelIndex < static_cast<int>(modelTransforms.size())
+				? modelTransforms[modelIndex] : Mat4<float>();
 
-		// Read nodes data
-		nodes.load(file, lumps[static_cast<int>(LUMPS::NODES)]);
+			if (!queueModel(modelIndex, transform))
+				culledModels++;
+		}
 
-		//nodes.displayData();
-		//nodes.validate();
-		//std::cin.get();
+		submitRenderQueue();
 
-		// Read leaves data
-		leaves.load(file, lumps[static_cast<int>(LUMPS::LEAVES)]);
+		// The boxes are tested against the finished depth buffer, the answers are used next frame
+		if (occlusion) {
+			pullUpOcclusion();
+			occlusionQueryCount = occlusionQueries.issue();
+			drawCalls += occlusionQueryCount;
+		}
 
-		//leaves.displayData();
-		//leaves.validate();
-		//std::cin.get();
+		// Billboards use their own program, the caller's one is bound again afterwards
+		if (renderBillboards && billboards.size() > 0) {
+			drawCalls += billboards.draw();
+			GLStateCache::shared().useProgram(shaderProgram);
+		}
+	}
 
-		// Read planes data
-		planes.load(file, lumps[static_cast<int>(LUMPS::PLANES)]);
 
-		//planes.displayData();
-		//planes.validate();
-		//std::cin.get();
+	int Loader::cullLeaves(const Mat4<float>& viewProjection, std::vector<int>& visibleLeaves) {
+		visibleLeaves.clear();
+		if (loadState != LoadState::Ready)
+			return 0;
 
-		// Read pvs (potentially visible sets) data
-		pvs.load(file, lumps[static_cast<int>(LUMPS::PVS)]);
+		occlusionRasterizer.render(viewProjection);
 
-		//pvs.displayData();
-		//pvs.validate();
-		//std::cin.get();
+		int hidden = 0;
+		LumpView<Leaf> allLeaves = leaves.getData();
+		for (int leafIndex = 0; leafIndex < static_cast<int>(allLeaves.size()); leafIndex++) {
+			const Leaf& leaf = allLeaves[leafIndex];
+			if (leaf.getCluster() < 0)
+				continue;
 
-		// Read brushes data
-		brushes.load(file, lumps[static_cast<int>(LUMPS::BRUSHES)]);
+			if (occlusionRasterizer.isVisible(occlusionBounds(leaf.getMin(), leaf.getMax())))
+				visibleLeaves.push_back(leafIndex);
+			else
+				hidden++;
+		}
 
-		//brushes.displayData();
-		//brushes.validate();
-		//std::cin.get();
+		return hidden;
+	}
 
-		// Read brush sides data
-		brushsides.load(file, lumps[static_cast<int>(LUMPS::BRUSH_SIDES)]);
+	bool Loader::drawModel(int modelIndex, const Mat4<float>& transform) {
+		if (headless || loadState != LoadState::Ready)
+			return false;
 
-		//brushsides.displayData();
-		//brushsides.validate();
-		//std::cin.get();
+		renderQueue.clear();
+		if (!queueModel(modelIndex, transform))
+			return false;
 
-		// Read indices data
-		indices.load(file,
-			lumps[static_cast<int>(LUMPS::INDICES)].length,
-			lumps[static_cast<int>(LUMPS::INDICES)].offset);
+		submitRenderQueue();
+		return true;
+	}
 
-		//indices.displayData();
-		//std::cin.get();
+	void Loader::setModelTransform(int modelIndex, const Mat4<float>& transform) {
+		if (modelIndex < 0)
+			return;
 
-		// Read leaf faces data
-		leafFaces.load(file,
-			lumps[static_cast<int>(LUMPS::LEAF_FACES)].length,
-			lumps[static_cast<int>(LUMPS::LEAF_FACES)].offset);
+		if (modelIndex >= static_cast<int>(modelTransforms.size()))
+			modelTransforms.resize(modelIndex + 1);
 
-		// Read leaf brushes data
-		leafBrushes.load(file,
-			lumps[static_cast<int>(LUMPS::LEAF_BRUSHES)].length,
-			lumps[static_cast<int>(LUMPS::LEAF_BRUSHES)].offset);
+		modelTransforms[modelIndex] = transform;
 	}
 
-	void Loader::displayHeaderData(Header& header) {
-		std::cout << "BSP header data" << std::endl;
-		std::cout << header.strID << std::endl;
-		std::cout << header.version << std::endl;
+	// Queues the faces of a model unless its bounds are outside the view, returns false when culled.
+	// The world (model 0) is never culled.
+	bool Loader::queueModel(int modelIndex, const Mat4<float>& transform) {
+		if (modelIndex < 0 || modelIndex >= static_cast<int>(models.size()))
+			return false;
+
+		const Model& model = models.getData()[modelIndex];
+
+		if (modelIndex > 0 && cullModels && model.getBounds().isOutside(Mat4<float>(viewProjection * transform)))
+			return false;
+
+		queueFaces(model.getFace(), model.getNumOfFaces(), transform);
+		return true;
 	}
 
-	void Loader::displayLumpData(LumpData(&lumps)[static_cast<int>(LUMPS::MAXLUMPS)]) {
-		for (int i = 0; i < static_cast<int>(LUMPS::MAXLUMPS); i++) {
-			std::cout << "LUMP: " << i << std::endl;
-			std::cout << "Offset: " << lumps[i].offset << std::endl;
-			std::cout << "Length: " << lumps[i].length << std::endl;
+	void Loader::queueFaces(int firstFace, int numOfFaces, const Mat4<float>& transform) {
+		int lastFace = std::min(firstFace + numOfFaces, static_cast<int>(faces.size()));
+		int transformIndex = renderQueue.addTransform(transform);
+		if (transformIndex < 0)
+			return;
+
+		const float* m = transform.getData();
+
+		for (int faceIndex = std::max(firstFace, 0); faceIndex < lastFace; faceIndex++) {
+			const Vec3f& c = faceCenters[faceIndex];
+			Vec3f center(m[0] * c.x() + m[1] * c.y() + m[2] * c.z() + m[3],
+				m[4] * c.x() + m[5] * c.y() + m[6] * c.z() + m[7],
+				m[8] * c.x() + m[9] * c.y() + m[10] * c.z() + m[11]);
+			float distance = (center - cameraPosition).length();
+
+			queueFace(faceIndex, transformIndex, SortKey::quantizeDepth(distance, depthRange));
 		}
 	}
 
-	void Loader::drawLevel(const Vec3<float>& vPos, GLuint shaderProgram) {
-		this->shaderProgram = shaderProgram;
-		// For each face
-		for (int faceIndex = 0; faceIndex < faces.size(); faceIndex++) {
+	// Walks the world's BSP tree from the camera, nearer side of every split plane first, and queues
+	// the faces of each leaf in the order the leaves are reached. The rank becomes the depth of the key.
+	// With occlusion, nodes and leaves hidden by the last answers are skipped and queued for a query.
+	// With software occlusion, nodes, leaves and patches behind the rasterized occluders are skipped first.
+	void Loader::queueWorldFrontToBack(const Mat4<float>& transform, bool occlusion, bool software) {
+		int transformIndex = renderQueue.addTransform(transform);
+		if (transformIndex < 0)
+			return;
+
+		LumpView<Node> allNodes = nodes.getData();
+		LumpView<Leaf> allLeaves = leaves.getData();
+		LumpView<Plane> allPlanes = planes.getData();
+		LumpView<int> allLeafFaces = leafFaces.getView();
+
+		if (faceVisits.size() != faces.size())
+			faceVisits.assign(faces.size(), 0);
+		if (++visitStamp == 0) {
+			std::fill(faceVisits.begin(), faceVisits.end(), 0);
+			visitStamp = 1;
+		}
+
+		const uint32_t lastRank = (1u << SortKey::DEPTH_BITS) - 1;
+		uint32_t rank = 0;
+
+		nodeStack.clear();
+		nodeStack.push_back(0);
+
+		while (!nodeStack.empty()) {
+			int child = nodeStack.back();
+			nodeStack.pop_back();
+
+			// Negative children are leaves, stored as -(leaf + 1)
+			if (child < 0) {
+				int leafIndex = -(child + 1);
+				if (leafIndex >= static_cast<int>(allLeaves.size()))
+					continue;
+
+				const Leaf& leaf = allLeaves[leafIndex];
+
+				if (software && leaf.getNumOfLeafFaces() > 0 && !occlusionRasterizer.isVisible(occlusionBounds(leaf.getMin(), leaf.getMax()))) {
+					softwareCulledLeaves++;
+					continue;
+				}
+
+				if (occlusion) {
+					int object = static_cast<int>(allNodes.size()) + leafIndex;
+
+					// Leaves without faces hide nothing, they never keep their parents visible
+					if (leaf.getNumOfLeafFaces() <= 0) {
+						occlusionQueries.setVisible(object, false);
+						continue;
+					}
+
+					// Hidden leaves are tested every frame, visible ones every few frames
+					if (!occlusionQueries.isVisible(object) || (occlusionFrame + leafIndex) % VISIBLE_QUERY_INTERVAL == 0)
+						requestOcclusionQuery(object, leaf.getMin(), leaf.getMax());
+
+					if (!occlusionQueries.isVisible(object)) {
+						occludedLeaves++;
+						continue;
+					}
+				}
+
+				int first = std::max(leaf.getLeafFace(), 0);
+				int last = std::min(leaf.getLeafFace() + leaf.getNumOfLeafFaces(), static_cast<int>(allLeafFaces.size()));
+
+				for (int i = first; i < last; i++) {
+					int faceIndex = allLeafFaces[i];
+					if (faceIndex < 0 || faceIndex >= static_cast<int>(faces.size()) || faceVisits[faceIndex] == visitStamp)
+						continue;
+
+					faceVisits[faceIndex] = visitStamp;
+
+					// Patches are the most triangles per face, their control points bound them
+					if (software && faces.getData()[faceIndex].getType() == FACE_PATCH &&
+						!occlusionRasterizer.isVisible(faceBounds[faceIndex])) {
+						softwareCulledPatches++;
+						continue;
+					}
+
+					if (queueFace(faceIndex, transformIndex, rank) && rank < lastRank)
+						rank++;
+				}
+				continue;
+			}
+
+			if (child >= static_cast<int>(allNodes.size()))
+				continue;
+
+			const Node& node = allNodes[child];
+			if (node.getPlane() < 0 || node.getPlane() >= static_cast<int>(allPlanes.size()))
+				continue;
+
+			if ((occlusion || software) && subtreeLeaves[child] == 0)
+				continue;
+
+			if (software && !occlusionRasterizer.isVisible(occlusionBounds(node.getMin(), node.getMax()))) {
+				softwareCulledLeaves += subtreeLeaves[child];
+				continue;
+			}
+
+			if (occlusion) {
+
+				if (!occlusionQueries.isVisible(child)) {
+					requestOcclusionQuery(child, node.getMin(), node.getMax());
+					if (!occlusionQueries.isVisible(child)) {
+						occludedLeaves += subtreeLeaves[child];
+						continue;
+					}
+				}
+
+				walkedNodes.push_back(child);
+			}
+
+			const Plane& plane = allPlanes[node.getPlane()];
+			float side = plane.getNormal().dot(cameraPosition) - plane.getDistanceFromOrigin();
+
+			// The stack pops the last push first, so the far side goes in first
+			if (side >= 0.0f) {
+				nodeStack.push_back(node.getBack());
+				nodeStack.push_back(node.getFront());
+			}
+			else {
+				nodeStack.push_back(node.getFront());
+				nodeStack.push_back(node.getBack());
+			}
+		}
+
+		// Texture order draws them too
+		for (int faceIndex : unreferencedFaces) {
+			if (queueFace(faceIndex, transformIndex, rank) && rank < lastRank)
+				rank++;
+		}
+	}
+
+	// Pushes one face unless its type is switched off or it has nothing to draw, returns true when queued
+	bool Loader::queueFace(int faceIndex, int transformIndex, uint32_t depth) {
+		const BSP::Face& face = faces.getData()[faceIndex];
+		int stream;
+
+		// Se a primeira flag estiver TRUE, renderiza polygon e mesh, mas no patches.
+		if (renderPolygonsAndMeshes &&
+			(face.getType() == BSP::FACE_POLYGON || face.getType() == BSP::FACE_MESH))
+			stream = STREAM_FACES;
+		// Se a segunda flag estiver TRUE, renderiza patches, mas no polygon e mesh.
+		else if (renderPatches && face.getType() == BSP::FACE_PATCH)
+			stream = STREAM_PATCHES;
+		else
+			return false;
+
+		const DrawRange& range = faceRanges[faceIndex];
+		if (range.count == 0)
+			return false;
+
+		// Front to back leaves texture and lightmap out of the key, so inside a bucket only the depth counts
+		int texture = frontToBack ? 0 : face.getTextureID();
+		int lightmap = frontToBack ? 0 : face.getLightmapID() + 1;
+
+		// One draw per quadratic patch, at the level its distance asks for
+		if (stream == STREAM_PATCHES && patchLodScale > 0.0f) {
+			patchRanges.clear();
+			patchLod.select(faceIndex, renderQueue.getTransform(transformIndex), cameraPosition, patchLodScale, patchRanges);
+
+			uint64_t key = SortKey::make(0, transformIndex, texture, lightmap, STREAM_PATCH_LOD, depth);
+			for (const DrawRange& patchRange : patchRanges) {
+				renderQueue.push(key, patchRange);
+				patchTriangles += patchRange.count / 3;
+			}
+			return !patchRanges.empty();
+		}
+
+		if (stream == STREAM_PATCHES)
+			patchTriangles += range.count / 3;
+
+		renderQueue.push(SortKey::make(0, transformIndex, texture, lightmap, stream, depth), range);
+		return true;
+	}
+
+	void Loader::submitRenderQueue() {
+		renderQueue.sort();
+
+		renderBackend.setProgram(0, shaderProgram);
+		renderBackend.setStreamVAO(STREAM_FACES, faceVAO);
+		renderBackend.setStreamVAO(STREAM_PATCHES, patchVAO);
+		renderBackend.setStreamVAO(STREAM_PATCH_LOD, patchLodVAO);
+
+		GLStateCache& state = GLStateCache::shared();
+		drawCalls = 0;
+
+		// Depth only first, the color pass then only passes the depth test on the nearest surface
+		if (depthPrepass) {
+			state.colorMask(false);
+			drawCalls += renderBackend.execute(renderQueue);
+			state.colorMask(true);
+			state.depthMask(false);
+			state.depthFunc(GL_LEQUAL);
+		}
+
+		beginFragmentQuery();
+		drawCalls += renderBackend.execute(renderQueue);
+		endFragmentQuery();
+
+		if (depthPrepass) {
+			state.depthMask(true);
+			state.depthFunc(GL_LESS);
+		}
+	}
+
+	void Loader::beginFragmentQuery() {
+		if (!measureFragments)
+			return;
+
+		if (fragmentQueries[0] == 0)
+			glGenQueries(2, fragmentQueries);
+
+		// This query was ended two passes ago, skip a measurement rather than wait for it
+		GLuint query = fragmentQueries[fragmentQuery];
+		if (fragmentQueryPending[fragmentQuery]) {
+			GLint available = 0;
+			glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+			if (!available)
+				return;
+
+			GLuint64 samples = 0;
+			glGetQueryObjectui64v(query, GL_QUERY_RESULT, &samples);
+			fragmentCount = samples;
+			fragmentQueryPending[fragmentQuery] = false;
+		}
+
+		glBeginQuery(GL_SAMPLES_PASSED, query);
+		fragmentQueryActive = true;
+	}
+
+	void Loader::endFragmentQuery() {
+		if (!fragmentQueryActive)
+			return;
+
+		glEndQuery(GL_SAMPLES_PASSED);
+		fragmentQueryPending[fragmentQuery] = true;
+		fragmentQuery ^= 1;
+		fragmentQueryActive = false;
+	}
+
+	void Loader::initializeOcclusion() {
+		occlusionQueries.create(static_cast<int>(nodes.size() + leaves.size()));
+	}
+
+	void Loader::initializeSubtreeLeaves() {
+		int nodeCount = static_cast<int>(nodes.size());
+		LumpView<Node> allNodes = nodes.getData();
+		LumpView<Leaf> allLeaves = leaves.getData();
+
+		// Parents are listed before their children, so summing in reverse sees every child first
+		std::vector<int> order;
+		nodeStack.assign(1, 0);
+		while (!nodeStack.empty()) {
+			int node = nodeStack.back();
+			nodeStack.pop_back();
+			if (node < 0 || node >= nodeCount)
+				continue;
+
+			order.push_back(node);
+			nodeStack.push_back(allNodes[node].getFront());
+			nodeStack.push_back(allNodes[node].getBack());
+		}
+
+		subtreeLeaves.assign(nodeCount, 0);
+		for (auto it = order.rbegin(); it != order.rend(); ++it) {
+			int children[] = { allNodes[*it].getFront(), allNodes[*it].getBack() };
+			for (int child : children) {
+				if (child >= 0) {
+					subtreeLeaves[*it] += child < nodeCount ? subtreeLeaves[child] : 0;
+				}
+				else {
+					int leafIndex = -(child + 1);
+					if (leafIndex < static_cast<int>(allLeaves.size()) && allLeaves[leafIndex].getNumOfLeafFaces() > 0)
+						subtreeLeaves[*it]++;
+				}
+			}
+		}
+	}
+
+	void Loader::requestOcclusionQuery(int object, const Vec3i& min, const Vec3i& max) {
+		BoundingBox bounds = occlusionBounds(min, max);
+
+		bool cameraInside = true;
+		for (int i = 0; i < 3; i++) {
+			if (cameraPosition[i] < bounds.min[i] - OCCLUSION_CAMERA_MARGIN || cameraPosition[i] > bounds.max[i] + OCCLUSION_CAMERA_MARGIN)
+				cameraInside = false;
+		}
+
+		if (!cameraInside) {
+			occlusionQueries.request(object, bounds);
+			return;
+		}
+
+		if (object < static_cast<int>(nodes.size()) && !occlusionQueries.isVisible(object))
+			revealSubtree(object);
+		occlusionQueries.setVisible(object, true);
+	}
+
+	void Loader::revealSubtree(int node) {
+		int nodeCount = static_cast<int>(nodes.size());
+		LumpView<Node> allNodes = nodes.getData();
+
+		// Separate stack, this runs in the middle of the tree walk
+		std::vector<int> pending(1, node);
+		while (!pending.empty()) {
+			int child = pending.back();
+			pending.pop_back();
+
+			if (child < 0) {
+				int leafIndex = -(child + 1);
+				if (nodeCount + leafIndex < occlusionQueries.size())
+					occlusionQueries.setVisible(nodeCount + leafIndex, true);
+				continue;
+			}
+
+			if (child >= nodeCount)
+				continue;
+
+			occlusionQueries.setVisible(child, true);
+			pending.push_back(allNodes[child].getFront());
+			pending.push_back(allNodes[child].getBack());
+		}
+	}
+
+	// A node stays visible while one of its children is, a node whose children are all hidden is
+	// tested as a whole from the next frame on
+	void Loader::pullUpOcclusion() {
+		int nodeCount = static_cast<int>(nodes.size());
+		LumpView<Node> allNodes = nodes.getData();
+
+		// Subtrees without faces are never walked, they don't count as visible
+		auto isVisible = [&](int child) {
+			if (child >= 0)
+				return child < nodeCount && subtreeLeaves[child] > 0 && occlusionQueries.isVisible(child);
+
+			int object = nodeCount - (child + 1);
+			return object < occlusionQueries.size() && occlusionQueries.isVisible(object);
+		};
+
+		for (auto it = walkedNodes.rbegin(); it != walkedNodes.rend(); ++it) {
+			const Node& node = allNodes[*it];
+			occlusionQueries.setVisible(*it, isVisible(node.getFront()) || isVisible(node.getBack()));
+		}
+	}
+
+	void Loader::initializeFaceCenters() {
+		faceCenters.assign(faces.size(), Vec3f(0.0f, 0.0f, 0.0f));
+		faceBounds.assign(faces.size(), BoundingBox{ Vec3f(0.0f, 0.0f, 0.0f), Vec3f(0.0f, 0.0f, 0.0f) });
+
+		const float largest = std::numeric_limits<float>::max();
+		Vec3f min(largest, largest, largest);
+		Vec3f max(-largest, -largest, -largest);
+
+		for (int faceIndex = 0; faceIndex < static_cast<int>(faces.size()); faceIndex++) {
 			const BSP::Face& face = faces.getData()[faceIndex];
 
-			// Se a primeira flag estiver TRUE, renderiza polygon e mesh, mas no patches.
-			if (renderPolygonsAndMeshes &&
-				(face.getType() == BSP::FACE_POLYGON || face.getType() == BSP::FACE_MESH)) {
-				drawFace(faceIndex);
+			// Patches use their control points, billboards have no vertices to draw
+			int first = std::max(face.getStartVertIndex(), 0);
+			int last = std::min(face.getStartVertIndex() + face.getNumOfVerts(), static_cast<int>(vertices.size()));
+			if (face.getType() == BSP::FACE_BBOARD || first >= last)
+				continue;
+
+			Vec3f sum(0.0f, 0.0f, 0.0f);
+			BoundingBox& bounds = faceBounds[faceIndex];
+			bounds.min = bounds.max = vertices.getData()[first].getPosition();
+			for (int vertexIndex = first; vertexIndex < last; vertexIndex++) {
+				const Vec3f& position = vertices.getData()[vertexIndex].getPosition();
+				sum = sum + position;
+				for (int i = 0; i < 3; i++) {
+					bounds.min[i] = std::min(bounds.min[i], position[i] - OCCLUSION_BOX_PADDING);
+					bounds.max[i] = std::max(bounds.max[i], position[i] + OCCLUSION_BOX_PADDING);
+				}
 			}
 
-			// Se a segunda flag estiver TRUE, renderiza patches, mas no polygon e mesh.
-			if (renderPatches && face.getType() == BSP::FACE_PATCH) {
-				drawFace(faceIndex);
+			Vec3f center = sum * (1.0f / (last - first));
+			faceCenters[faceIndex] = center;
+
+			for (int i = 0; i < 3; i++) {
+				min[i] = std::min(min[i], center[i]);
+				max[i] = std::max(max[i], center[i]);
 			}
 		}
+
+		depthRange = min.x() <= max.x() ? (max - min).length() : 0.0f;
+	}
+
+	// addict.bsp has such a patch
+	void Loader::initializeUnreferencedFaces() {
+		unreferencedFaces.clear();
+
+		LumpView<Model> allModels = models.getData();
+		if (allModels.empty())
+			return;
+
+		std::vector<char> referenced(faces.size(), 0);
+		for (int faceIndex : leafFaces.getView()) {
+			if (faceIndex >= 0 && faceIndex < static_cast<int>(faces.size()))
+				referenced[faceIndex] = 1;
+		}
+
+		int lastFace = std::min(allModels[0].getFace() + allModels[0].getNumOfFaces(), static_cast<int>(faces.size()));
+		for (int faceIndex = std::max(allModels[0].getFace(), 0); faceIndex < lastFace; faceIndex++) {
+			if (!referenced[faceIndex])
+				unreferencedFaces.push_back(faceIndex);
+		}
+	}
+
+	void Loader::initializeLightGrid() {
+		lightGrid.clear();
+
+		if (lightVolumes.size() == 0 || models.size() == 0)
+			return;
+
+		// Quake III's default cell size, worldspawn may override it
+		Vec3f gridSize(64.0f, 64.0f, 128.0f);
+		const Entity* worldspawn = entities.findFirstByClassname("worldspawn");
+		if (worldspawn)
+			worldspawn->getVector("gridsize", gridSize);
+
+		lightGrid.build(lightVolumes, models.getData()[0], gridSize);
 	}
 
-	void Loader::initializeFaces() {
-		std::vector<float> bufferVertexData;
+	void Loader::initializeGeometry() {
+		std::string cachePath = MapCache::pathFor(filename);
+		uint64_t cacheKey = 0;
+		bool cacheKeyValid = useMapCache && MapCache::computeKey(filename, tesselationLevel, vertexFormat.id(),
+			(optimizeIndices ? 1 : 0) | (optimizeOverdraw ? 2 : 0), cacheKey);
+
+		// Warm start: the cooked buffers are uploaded straight from the mapped cache file
+		if (cacheKeyValid && mapCache.open(cachePath, cacheKey)) {
+			std::cout << "Loaded cooked map cache '" << cachePath << "'" << std::endl;
+
+			LumpView<DrawRange> cachedRanges = mapCache.getFaceRanges();
+			faceRanges.assign(cachedRanges.begin(), cachedRanges.end());
+
+			// The cache stays mapped until the upload is done
+			pendingUpload.faceVertexData = mapCache.getFaceVertexData();
+			pendingUpload.faceIndexData = mapCache.getFaceIndexData();
+			pendingUpload.patchVertexData = mapCache.getPatchVertexData();
+			pendingUpload.patchIndexData = mapCache.getPatchIndexData();
+			return;
+		}
+
+		CookedGeometry& geometry = cookedGeometry;
+		geometry.faceRanges.assign(faces.size(), DrawRange{ 0, 0, 0 });
+
+		initializeFaces(geometry);
+		initializeBezierPatches(geometry);
+		optimizeIndexOrder(geometry);
+
+		if (cacheKeyValid && MapCache::write(cachePath, cacheKey, geometry)) {
+			std::cout << "Wrote cooked map cache '" << cachePath << "'" << std::endl;
+		}
+
+		faceRanges = geometry.faceRanges;
+
+		pendingUpload.faceVertexData = LumpView<unsigned char>(geometry.faceVertexData.data(), geometry.faceVertexData.size());
+		pendingUpload.faceIndexData = LumpView<GLuint>(geometry.faceIndexData.data(), geometry.faceIndexData.size());
+		pendingUpload.patchVertexData = LumpView<unsigned char>(geometry.patchVertexData.data(), geometry.patchVertexData.size());
+		pendingUpload.patchIndexData = LumpView<GLuint>(geometry.patchIndexData.data(), geometry.patchIndexData.size());
+	}
+
+	void Loader::releasePendingGeometry() {
+		pendingUpload = PendingUpload();
+		cookedGeometry = CookedGeometry();
+		patchLod.releaseIndices();
+		mapCache.close();
+	}
+
+	// Reorders the indices of each face inside its own range, so the draw table stays valid
+	void Loader::optimizeIndexOrder(CookedGeometry& geometry) {
+		if (!optimizeIndices)
+			return;
+
+		const int stride = vertexFormat.stride();
+		std::vector<CacheStats> before(faces.size());
+		std::vector<CacheStats> after(faces.size());
+
+		ThreadPool::shared().parallelFor(static_cast<int>(faces.size()), [&](int faceIndex) {
+			int type = faces.getData()[faceIndex].getType();
+			const DrawRange& range = geometry.faceRanges[faceIndex];
+			if (range.count == 0)
+				return;
+
+			bool isPatch = type == BSP::FACE_PATCH;
+			GLuint* indices = (isPatch ? geometry.patchIndexData : geometry.faceIndexData).data() + range.first;
+			const unsigned char* vertexData = (isPatch ? geometry.patchVertexData : geometry.faceVertexData).data()
+				+ static_cast<size_t>(range.baseVertex) * stride;
+
+			before[faceIndex] = measureVertexCache(indices, range.count);
+			BSP::optimizeIndexOrder(indices, range.count, vertexData, stride, optimizeOverdraw);
+			after[faceIndex] = measureVertexCache(indices, range.count);
+		});
+
+		CacheStats total[2][2];  // [polygons and meshes, patches][before, after]
+		for (int faceIndex = 0; faceIndex < static_cast<int>(faces.size()); faceIndex++) {
+			int stream = faces.getData()[faceIndex].getType() == BSP::FACE_PATCH ? 1 : 0;
+			total[stream][0].triangles += before[faceIndex].triangles;
+			total[stream][0].misses += before[faceIndex].misses;
+			total[stream][1].triangles += after[faceIndex].triangles;
+			total[stream][1].misses += after[faceIndex].misses;
+		}
+
+		std::cout << "vertex cache ACMR (" << VERTEX_CACHE_SIZE << " entries) faces: " << total[0][0].acmr()
+			<< " -> " << total[0][1].acmr() << ", patches: " << total[1][0].acmr()
+			<< " -> " << total[1][1].acmr() << std::endl;
+	}
+
+	void Loader::initializeFaces(CookedGeometry& geometry) {
+		std::vector<unsigned char>& bufferVertexData = geometry.faceVertexData;
+		std::vector<GLuint>& bufferIndexData = geometry.faceIndexData;
+		const size_t stride = vertexFormat.stride();
 
 		int totalPolygons = 0;
 		int totalMeshes = 0;
@@ -224,23 +1068,25 @@ namespace BSP {
 
 			if (face.getType() == BSP::FACE_POLYGON ||
 				face.getType() == BSP::FACE_MESH) {
-				faceToOffsetMap[faceIndex] = bufferVertexData.size();
+				// Each vertex of the face is stored once and its mesh indices are used as they are,
+				// relative to the face's first vertex (the base vertex of the draw)
+				geometry.faceRanges[faceIndex] = DrawRange{ static_cast<int>(bufferIndexData.size()),
+					face.getNumOfIndices(), static_cast<int>(bufferVertexData.size() / stride) };
+
+				size_t offset = bufferVertexData.size();
+				bufferVertexData.resize(offset + face.getNumOfVerts() * stride);
+
+				int endVertex = face.getStartVertIndex() + face.getNumOfVerts();
+				for (int vertexIndex = face.getStartVertIndex(); vertexIndex < endVertex; vertexIndex++) {
+					vertexFormat.write(vertices.getData()[vertexIndex], &bufferVertexData[offset]);
+					offset += stride;
+				}
 
 				int startMeshVert = face.getStartIndex();
 				int endMeshVert = startMeshVert + face.getNumOfIndices();
 
 				for (int index = startMeshVert; index < endMeshVert; index++) {
-					int meshVertIndex = indices.getValues()[index];
-
-					const Vertex& vertex = vertices.getData()[face.getStartVertIndex() + meshVertIndex];
-
-					bufferVertexData.push_back(vertex.getPosition().x());
-					bufferVertexData.push_back(vertex.getPosition().y());
-					bufferVertexData.push_back(vertex.getPosition().z());
-
-					for (int i = 0; i < 4; i++) {
-						bufferVertexData.push_back(static_cast<float>(vertex.getColor()[i]) / 255.0f);
-					}
+					bufferIndexData.push_back(static_cast<GLuint>(indices[index]));
 				}
 			}
 		}
@@ -249,79 +1095,72 @@ namespace BSP {
 		std::cout << "total meshes:" << totalMeshes << std::endl;
 		std::cout << "total patches:" << totalPatches << std::endl;
 		std::cout << "total billboards:" << totalBillboards << std::endl;
+	}
 
-		glGenVertexArrays(1, &faceVAO);
-		glBindVertexArray(faceVAO);
+	// Deletes the VAOs and buffers of the map, a new load creates them again
+	void Loader::deleteGeometryBuffers() {
+		if (faceVAO == 0)
+			return;
 
-		glGenBuffers(1, &faceVBO);
+		// Delete the unique VAO
+		glDeleteVertexArrays(1, &faceVAO);
 
-		glBindBuffer(GL_ARRAY_BUFFER, faceVBO);
-		glBufferData(GL_ARRAY_BUFFER, bufferVertexData.size() * sizeof(float),
-			bufferVertexData.data(), GL_STATIC_DRAW);
+		// Se voc tiver um VBO e EBO globais, tambm pode delet-los aqui.
+		glDeleteBuffers(1, &faceVBO);
+		glDeleteBuffers(1, &faceEBO);
 
-		// Atributo para posio do vrtice
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 7 * sizeof(float), (void*)0);
-		glEnableVertexAttribArray(0);
+		glDeleteVertexArrays(1, &patchVAO);
+		glDeleteBuffers(1, &patchVBO);
+		glDeleteBuffers(1, &patchEBO);
 
-		// Atributo para cor do vrtice
-		glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, 7 * sizeof(float), (void*)(3 * sizeof(float)));
-		glEnableVertexAttribArray(1);
+		glDeleteVertexArrays(1, &patchLodVAO);
+		glDeleteBuffers(1, &patchLodEBO);
 
-		glBindVertexArray(0);
+		faceVAO = faceVBO = faceEBO = 0;
+		patchVAO = patchVBO = patchEBO = 0;
+		patchLodVAO = patchLodEBO = 0;
 	}
 
-	void Loader::initializeBezierPatches() {
-		std::vector<float> bufferPatchVertexData;
-		std::vector<GLuint> bufferPatchIndexData;
+	// GL objects left by a previous load of this loader, on the GL thread before the new map's are made.
+	// Billboards keep their quad and program, their next upload() replaces the instances.
+	void Loader::releasePreviousLoad() {
+		deleteGeometryBuffers();
+		lightmaps.deleteTextures();
 
-		// Contando o nmero de patches
-		int numPatches = 0;
-		for (int faceIndex = 0; faceIndex < faces.size(); ++faceIndex) {
-			const BSP::Face& face = faces.getData()[faceIndex];
-			if (face.getType() == FACE_PATCH)
-				numPatches++;
-		}
+		// Queries sized for the previous map would be indexed past their end by the new nodes and leaves
+		if (occlusionQueries.isCreated())
+			initializeOcclusion();
+	}
 
-		// Reservando espao para os dados de patch
-		patches.reserve(numPatches);
+	// Creates the VAOs and buffers for the pending geometry. Without uploadData the buffers are
+	// only allocated and have to be filled by uploadGeometrySlice().
+	void Loader::createGeometryBuffers(bool uploadData) {
+		releasePreviousLoad();
 
-		int accumulator;
+		LumpView<unsigned char> faceVertexData = pendingUpload.faceVertexData;
+		LumpView<GLuint> faceIndexData = pendingUpload.faceIndexData;
+		LumpView<unsigned char> patchVertexData = pendingUpload.patchVertexData;
+		LumpView<GLuint> patchIndexData = pendingUpload.patchIndexData;
+		LumpView<GLuint> patchLodIndexData = pendingUpload.patchLodIndexData;
 
-		// Inicializando dados de patch
-		for (int faceIndex = 0; faceIndex < faces.size(); ++faceIndex) {
-			const BSP::Face& face = faces.getData()[faceIndex];
-			if (face.getType() == FACE_PATCH) {
-				patchToOffsetMap[faceIndex] = bufferPatchVertexData.size();
-				indexPatchToOffsetMap[faceIndex] = bufferPatchIndexData.size();
-
-				// Criar um objeto PatchData usando o construtor
-				PatchData patchData(faceIndex, face.getTextureID(),
-					face.getLightmapID(), face.getBezierPatchesSize()[0],
-					face.getBezierPatchesSize()[1]);
-
-				// Chamando uma funo separada para inicializar os patches quadrticos
-				initializeQuadraticPatches(patchData, face, this->tesselationLevel);
-				patches.push_back(patchData);
-
-				accumulator = 0;
-				for (const QuadraticPatch& quadPatch : patchData.getQuadraticPatches()) {
-					for (const Vertex& vertex : quadPatch.getVertices()) {
-						bufferPatchVertexData.push_back(vertex.getPosition().x());
-						bufferPatchVertexData.push_back(vertex.getPosition().y());
-						bufferPatchVertexData.push_back(vertex.getPosition().z());
-
-						for (int i = 0; i < 4; i++)
-							bufferPatchVertexData.push_back(static_cast<float>(vertex.getColor()[i]) / 255.0f);
-					}
+		glGenVertexArrays(1, &faceVAO);
+		glBindVertexArray(faceVAO);
 
-					// Adicionando os ndices de tringulo no EBO
-					for (const int& index : quadPatch.getIndices().getValues()) {
-						bufferPatchIndexData.push_back(index + patchToOffsetMap[faceIndex] / 7 + accumulator);
-					}
-					accumulator += (this->tesselationLevel + 1) * (this->tesselationLevel + 1);
-				}
-			}
-		}
+		glGenBuffers(1, &faceVBO);
+
+		glBindBuffer(GL_ARRAY_BUFFER, faceVBO);
+		glBufferData(GL_ARRAY_BUFFER, faceVertexData.size(),
+			uploadData ? faceVertexData.data() : nullptr, GL_STATIC_DRAW);
+
+		// The element buffer binding is part of the VAO state
+		glGenBuffers(1, &faceEBO);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, faceEBO);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, faceIndexData.size() * sizeof(GLuint),
+			uploadData ? faceIndexData.data() : nullptr, GL_STATIC_DRAW);
+
+		vertexFormat.setupAttributes();
+
+		glBindVertexArray(0);
 
 		// Gerao e ligao do VAO para patches
 		glGenVertexArrays(1, &patchVAO);
@@ -336,111 +1175,164 @@ namespace BSP {
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, patchEBO);
 
 		// Supondo que bufferPatchVertexData seja o vetor contendo seus dados de vrtice de patch
-		glBufferData(GL_ARRAY_BUFFER, bufferPatchVertexData.size() * sizeof(float),
-			bufferPatchVertexData.data(), GL_STATIC_DRAW);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, bufferPatchIndexData.size() * sizeof(GLuint),
-			bufferPatchIndexData.data(), GL_STATIC_DRAW);
-
-		// Atributo para posio do vrtice
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 7 * sizeof(float), (void*)0);
-		glEnableVertexAttribArray(0);
+		glBufferData(GL_ARRAY_BUFFER, patchVertexData.size(),
+			uploadData ? patchVertexData.data() : nullptr, GL_STATIC_DRAW);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, patchIndexData.size() * sizeof(GLuint),
+			uploadData ? patchIndexData.data() : nullptr, GL_STATIC_DRAW);
 
-		// Atributo para cor do vrtice
-		glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, 7 * sizeof(float), (void*)(3 * sizeof(float)));
-		glEnableVertexAttribArray(1);
+		vertexFormat.setupAttributes();
 
 		glBindVertexArray(0);
-	}
-
-	void Loader::initializeQuadraticPatches(PatchData& patchData, const Face& face, int tesselationLevel) {
-		int width = (patchData.getWidth() - 1) / 2;
-		int height = (patchData.getHeight() - 1) / 2;
-		patchData.resizeQuadraticPatches(width * height);
-
-		// ndice base para os vrtices desta face
-		int baseVertIndex = face.getStartVertIndex();
 
-		for (int y = 0; y < height; y++) {
-			for (int x = 0; x < width; x++) {
+		// Same vertices as the patch VAO with the index lists of the patch levels of detail
+		glGenVertexArrays(1, &patchLodVAO);
+		glBindVertexArray(patchLodVAO);
+		glBindBuffer(GL_ARRAY_BUFFER, patchVBO);
 
-				// Obtendo a referncia para o patch quadrtico atual
-				QuadraticPatch& quadPatch = patchData.getQuadraticPatches()[y * width + x];
+		glGenBuffers(1, &patchLodEBO);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, patchLodEBO);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, patchLodIndexData.size() * sizeof(GLuint),
+			uploadData ? patchLodIndexData.data() : nullptr, GL_STATIC_DRAW);
 
-				for (int r = 0; r < 3; r++) {
-					for (int c = 0; c < 3; c++) {
+		vertexFormat.setupAttributes();
 
-						// Calculando o ndice do vrtice no vetor de vrtices
-						int vertIndex = baseVertIndex + (y * 2 * patchData.getWidth() + x * 2) +
-							r * patchData.getWidth() + c;
-						const Vertex& vertex = vertices.getData()[vertIndex];
+		glBindVertexArray(0);
 
-						// Atribuindo valores aos pontos de controle
-						quadPatch.getControlPoints()[r * 3 + c] = vertex;
-					}
-				}
-				quadPatch.tesselate(tesselationLevel);
-			}
-		}
+		pendingUpload.buffersCreated = true;
 	}
 
-	void Loader::drawFace(int faceIndex) {
-		const BSP::Face& face = faces.getData()[faceIndex];
-
-		if (face.getType() == BSP::FACE_POLYGON || face.getType() == BSP::FACE_MESH)
-		{
-			// Bind VAO
-			glBindVertexArray(faceVAO);
-
-			glDrawArrays(GL_TRIANGLES, static_cast<GLuint>(faceToOffsetMap[faceIndex] / 7),
-				face.getNumOfIndices());
+	// Fills the buffers allocated by createGeometryBuffers(false) with at most budgetBytes per call,
+	// returns true once everything has been uploaded
+	bool Loader::uploadGeometrySlice(size_t budgetBytes) {
+		struct Target {
+			GLenum target;
+			GLuint vao;
+			GLuint buffer;
+			const char* data;
+			size_t size;
+		};
+
+		const Target targets[] = {
+			{ GL_ARRAY_BUFFER, faceVAO, faceVBO,
+				reinterpret_cast<const char*>(pendingUpload.faceVertexData.data()),
+				pendingUpload.faceVertexData.size() },
+			{ GL_ELEMENT_ARRAY_BUFFER, faceVAO, faceEBO,
+				reinterpret_cast<const char*>(pendingUpload.faceIndexData.data()),
+				pendingUpload.faceIndexData.size() * sizeof(GLuint) },
+			{ GL_ARRAY_BUFFER, patchVAO, patchVBO,
+				reinterpret_cast<const char*>(pendingUpload.patchVertexData.data()),
+				pendingUpload.patchVertexData.size() },
+			{ GL_ELEMENT_ARRAY_BUFFER, patchVAO, patchEBO,
+				reinterpret_cast<const char*>(pendingUpload.patchIndexData.data()),
+				pendingUpload.patchIndexData.size() * sizeof(GLuint) },
+			{ GL_ELEMENT_ARRAY_BUFFER, patchLodVAO, patchLodEBO,
+				reinterpret_cast<const char*>(pendingUpload.patchLodIndexData.data()),
+				pendingUpload.patchLodIndexData.size() * sizeof(GLuint) }
+		};
+
+		// The buffers are filled one after the other, as if they were a single stream
+		size_t targetStart = 0;
+		for (const Target& target : targets) {
+			size_t targetEnd = targetStart + target.size;
+
+			if (budgetBytes > 0 && pendingUpload.uploadedBytes < targetEnd) {
+				size_t offset = pendingUpload.uploadedBytes - targetStart;
+				size_t bytes = std::min(budgetBytes, target.size - offset);
+
+				// The element buffer binding belongs to the VAO
+				glBindVertexArray(target.vao);
+				glBindBuffer(target.target, target.buffer);
+				glBufferSubData(target.target, offset, bytes, target.data + offset);
+				glBindVertexArray(0);
+
+				pendingUpload.uploadedBytes += bytes;
+				budgetBytes -= bytes;
+			}
 
-			// Desvincule o VAO
-			glBindVertexArray(0);
+			targetStart = targetEnd;
 		}
-		else if (face.getType() == BSP::FACE_PATCH) {
-			// TODO: Certifique-se de que o ndice est correto aqui
-			PatchData& currentPatch = patches[faceIndex];
 
-			glBindVertexArray(patchVAO);
-			checkGLError("glBindVertexArray");
+		size_t totalBytes = targetStart;
+		if (totalBytes > 0) {
+			setLoadProgress(0.8f + 0.2f * pendingUpload.uploadedBytes / totalBytes, "Uploading geometry");
+		}
 
-			glBindBuffer(GL_ARRAY_BUFFER, patchVBO);
-			checkGLError("glBindBuffer");
+		return pendingUpload.uploadedBytes >= totalBytes;
+	}
 
-			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, patchEBO);
-			checkGLError("glBindBuffer");
+	// Every quadratic patch is tessellated straight into the cooked buffers, in face order
+	void Loader::initializeBezierPatches(CookedGeometry& geometry) {
+		std::vector<unsigned char>& bufferPatchVertexData = geometry.patchVertexData;
+		std::vector<GLuint>& bufferPatchIndexData = geometry.patchIndexData;
+		const size_t stride = vertexFormat.stride();
+		const PatchTessellator tessellator(tesselationLevel);
+		LumpView<Vertex> allVertices = vertices.getData();
+
+		// Where each patch face goes in the buffers, a prefix sum of the faces before it
+		struct PatchFace {
+			int faceIndex;
+			int firstVertex;
+			int firstIndex;
+		};
+		std::vector<PatchFace> patchFaces;
+		int vertexCount = static_cast<int>(bufferPatchVertexData.size() / stride);
+		int indexCount = static_cast<int>(bufferPatchIndexData.size());
 
-			// Obter o ndice inicial para este patch especfico. Isso depender de como voc armazenou seus dados.
-			GLuint startIndex = indexPatchToOffsetMap[faceIndex]; // Suponho que isso d o ndice inicial
-			GLuint accumulator = 0; // Acumulador para os ndices j processados
+		for (int faceIndex = 0; faceIndex < faces.size(); ++faceIndex) {
+			const BSP::Face& face = faces.getData()[faceIndex];
+			if (face.getType() != FACE_PATCH)
+				continue;
 
-			// Suponho que o ndice inicial e a contagem de ndices para cada patch estejam disponveis.
-			// Se no, voc pode calcular com base no tamanho da tesselao ou outras mtricas.
-			for (auto& quadPatch : currentPatch.getQuadraticPatches()) {
+			// The control points form a grid of controlWidth points per row, quadratic patches share their border points
+			int width = std::max((face.getBezierPatchesSize()[0] - 1) / 2, 0);
+			int height = std::max((face.getBezierPatchesSize()[1] - 1) / 2, 0);
+			int count = width * height * tessellator.getIndexCount();
 
-				// Obter a contagem de ndices para este patch
-				GLsizei indexCount = quadPatch.getIndices().getValues().size();
+			patchFaces.push_back(PatchFace{ faceIndex, vertexCount, indexCount });
+			geometry.faceRanges[faceIndex] = DrawRange{ indexCount, count, 0 };
 
-				// Renderize usando glDrawElements
-				glDrawElements(GL_TRIANGLES, indexCount,
-					GL_UNSIGNED_INT, (void*)((startIndex + accumulator) * sizeof(GLuint)));
+			vertexCount += width * height * tessellator.getVertexCount();
+			indexCount += count;
+		}
 
-				// Atualiza o acumulador
-				accumulator += indexCount;
+		// Allocated once, every face then writes its own slice and no thread touches another's
+		bufferPatchVertexData.resize(static_cast<size_t>(vertexCount) * stride);
+		bufferPatchIndexData.resize(indexCount);
+
+		std::atomic<int> patchesDone(0);
+
+		ThreadPool::shared().parallelFor(static_cast<int>(patchFaces.size()), [&](int patchFaceIndex) {
+			const PatchFace& patchFace = patchFaces[patchFaceIndex];
+			const BSP::Face& face = faces.getData()[patchFace.faceIndex];
+			int controlWidth = face.getBezierPatchesSize()[0];
+			int width = std::max((controlWidth - 1) / 2, 0);
+			int height = std::max((face.getBezierPatchesSize()[1] - 1) / 2, 0);
+
+			for (int y = 0; y < height; y++) {
+				for (int x = 0; x < width; x++) {
+					const Vertex* controlPoints[9];
+					for (int r = 0; r < 3; r++) {
+						for (int c = 0; c < 3; c++) {
+							int vertexIndex = face.getStartVertIndex() + (y * 2 * controlWidth + x * 2) + r * controlWidth + c;
+							controlPoints[r * 3 + c] = &allVertices[vertexIndex];
+						}
+					}
 
-				checkGLError("glDrawElements");
+					int patch = y * width + x;
+					int patchFirstVertex = patchFace.firstVertex + patch * tessellator.getVertexCount();
+					tessellator.tessellate(controlPoints, vertexFormat,
+						&bufferPatchVertexData[static_cast<size_t>(patchFirstVertex) * stride]);
+					tessellator.writeIndices(patchFirstVertex,
+						&bufferPatchIndexData[patchFace.firstIndex + static_cast<size_t>(patch) * tessellator.getIndexCount()]);
+				}
 			}
 
-			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-			checkGLError("Unbind EBO");
-
-			glBindVertexArray(0);
-			checkGLError("Unbind VAO");
-		}
+			advanceLoadProgress(0.3f + 0.5f * ++patchesDone / patchFaces.size(), "Tessellating patches");
+		});
 	}
 
 	void Loader::setTesselationLevel(int level) {
-		this->tesselationLevel = level;
+		this->tesselationLevel = std::min(std::max(level, 1), PatchTessellator::MAX_LEVEL);
 	}
 
 	void Loader::debugEBO(GLuint ebo, size_t indexCount) {
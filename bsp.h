@@ -1,6 +1,9 @@
 #pragma once
 
 #include <unordered_map>
+#include <functional>
+#include <atomic>
+#include <thread>
 #include <iostream>
 #include <fstream>
 #include <string>
@@ -10,6 +13,8 @@
 #include "GL_Utils.h"
 
 #include "BSPelement.h"
+#include "mappedFile.h"
+#include "mapCache.h"
 #include "vertices.h"
 #include "faces.h"
 #include "textures.h"
@@ -20,10 +25,22 @@
 #include "pvs.h"
 #include "brushes.h"
 #include "brushsides.h"
+#include "entities.h"
+#include "models.h"
+#include "lightVolumes.h"
+#include "lightGrid.h"
+#include "vertexFormat.h"
+#include "indexOptimizer.h"
+#include "billboards.h"
+#include "renderQueue.h"
+#include "renderBackend.h"
+#include "occlusionQueries.h"
+#include "occlusionRasterizer.h"
+#include "patchLod.h"
 
 #include "vector.h"
+#include "matrix.h"
 #include "indexedData.h"
-#include "bezierPatches.h"
 
 namespace BSP {
     // This is our BSP header structure
@@ -33,6 +50,23 @@ namespace BSP {
         int version;	// This should be 0x2e for Quake 3 files
     };
 
+    // How the .bsp file is brought into memory
+    enum class LoadMode
+    {
+        Streamed,       // Every lump is read into its own buffer through std::ifstream
+        MemoryMapped    // The file is mapped once and lumps are viewed in place when possible
+    };
+
+    // Where a load started with loadAsync() currently is
+    enum class LoadState
+    {
+        Idle,           // Nothing loaded yet
+        Loading,        // The worker thread is reading, parsing and tessellating
+        Uploading,      // The CPU work is done, updateAsyncLoad() is filling the GL buffers
+        Ready,          // The map can be drawn
+        Failed          // The file could not be loaded
+    };
+
     class Loader
     {
     public:
@@ -40,16 +74,154 @@ namespace BSP {
         ~Loader();
 
         bool load(const std::string& filename);
-        void loadLumps(std::ifstream& file);        
+        void loadLumps();
+
+        // Start loading on a worker thread, then call updateAsyncLoad() once per frame on the
+        // render thread until it returns true (or getLoadState() reports Failed)
+        bool loadAsync(const std::string& filename);
+        bool updateAsyncLoad(size_t uploadBudgetBytes);
+
+        LoadState getLoadState() const { return loadState; }
+        bool isLoaded() const { return loadState == LoadState::Ready; }
+        float getLoadProgress() const { return loadProgress; }     // From 0 to 1
+        const char* getLoadStage() const { return loadStage; }
+
+        // Draws the world model, then every submodel (doors, platforms...) with its transform
         void drawLevel(const Vec3<float>& vPos, GLuint shaderProgram);
 
+        // Draw one model with its own "model" matrix, culled by its bounds. Returns false when culled.
+        bool drawModel(int modelIndex, const Mat4<float>& transform);
+
+        // Camera projection * view (row-major, like the camera matrices), used to cull submodels
+        void setViewProjection(const Mat4<float>& matrix) { viewProjection = matrix; cullModels = true; }
+
+        // Camera view and projection (row-major), sets the view projection used for culling
+        void setViewMatrices(const Mat4<float>& view, const Mat4<float>& projection) { setViewProjection(Mat4<float>(projection * view)); }
+
+        // Where drawLevel() draws a submodel, identity until set
+        void setModelTransform(int modelIndex, const Mat4<float>& transform);
+        int getCulledModelCount() const { return culledModels; }
+
         void setRenderPolygonsAndMeshes(bool value) { renderPolygonsAndMeshes = value; }
         void setRenderPatches(bool value) { renderPatches = value; }
+        void setRenderBillboards(bool value) { renderBillboards = value; }
+        void setBillboardSize(float size) { billboardSize = size; }   // Half width in world units, set before loading
+
+        // Submit the visible faces with one multi-draw per state bucket (default) or one draw per face
+        void setBatchDraws(bool value) { renderBackend.setBatching(value); }
+        int getDrawCallCount() const { return drawCalls; }      // GL draw calls of the last drawLevel()
+
+        // Order the world faces front to back by walking the BSP tree from the camera, instead of
+        // grouping them by texture. With the depth pre-pass the queue is first drawn depth-only, so
+        // the color pass only shades the nearest surface of each pixel.
+        void setFrontToBack(bool value) { frontToBack = value; }
+        void setDepthPrepass(bool value) { depthPrepass = value; }
+        bool isFrontToBack() const { return frontToBack; }
+        bool hasDepthPrepass() const { return depthPrepass; }
+
+        // Count the fragments that pass the depth test in the color pass (GL_SAMPLES_PASSED).
+        // Results are read a couple of frames late so the query never stalls the pipeline.
+        void setMeasureFragments(bool value) { measureFragments = value; }
+        uint64_t getFragmentCount() const { return fragmentCount; }
+
+        // Skip the faces of leaves hidden behind what was drawn. The bounds of BSP nodes and leaves are
+        // tested with occlusion queries whose answers are used a frame or more later, so a leaf coming
+        // into view may appear a frame late. Walks the tree like setFrontToBack().
+        void setOcclusionCulling(bool value) { occlusionCulling = value; }
+        bool isOcclusionCulling() const { return occlusionCulling; }
+        int getOccludedLeafCount() const { return occludedLeaves; }         // Leaves skipped by the last drawLevel()
+        int getOcclusionQueryCount() const { return occlusionQueryCount; }  // Queries issued by the last drawLevel()
+
+        // Skip the leaves and patches hidden behind the largest walls of the map, rasterized on the CPU
+        // into a small depth buffer every frame. Needs setViewProjection() and walks the tree like
+        // setFrontToBack(). Set before loading for headless loads, which then keep the faces it uses.
+        void setSoftwareOcclusion(bool value) { softwareOcclusion = value; }
+        bool isSoftwareOcclusion() const { return softwareOcclusion; }
+        int getSoftwareCulledLeafCount() const { return softwareCulledLeaves; }     // By the last drawLevel()
+        int getSoftwareCulledPatchCount() const { return softwareCulledPatches; }   // By the last drawLevel()
+        const OcclusionRasterizer& getOcclusionRasterizer() const { return occlusionRasterizer; }
+
+        // Render the occluders seen through viewProjection and list the leaves inside the map (cluster >= 0)
+        // that are not hidden by them. Returns the number of hidden leaves. Works in headless loads.
+        int cullLeaves(const Mat4<float>& viewProjection, std::vector<int>& visibleLeaves);
+
+        // Tessellate each quadratic patch for its distance, with the coarsest level whose error stays
+        // under maxError pixels on a viewport viewportHeight pixels high. Neighbouring patches of a face
+        // are stitched, so they can differ without cracks. Needs setViewProjection(), without it the
+        // patches keep the full level.
+        void setPatchLod(bool value) { patchLodEnabled = value; }
+        bool isPatchLod() const { return patchLodEnabled; }
+        void setPatchLodError(float maxError, int viewportHeight) { patchLodError = maxError; this->viewportHeight = viewportHeight; }
+        int getPatchTriangleCount() const { return patchTriangles; }   // Queued by the last drawLevel()
+
+        // Sorted draws of the last drawLevel() or drawModel()
+        const RenderQueue& getRenderQueue() const { return renderQueue; }
+        void setLoadMode(LoadMode mode) { loadMode = mode; }
+        void setValidateLumps(bool value) { validateLumps = value; }
+        void setUseMapCache(bool value) { useMapCache = value; }
+
+        // Layout of the face and patch vertices, set before loading (packed by default)
+        void setVertexFormat(const VertexFormat& format) { vertexFormat = format; }
+        const VertexFormat& getVertexFormat() const { return vertexFormat; }
+
+        // Reorder the triangles of every face for the vertex cache when cooking (default), and
+        // optionally for less overdraw. Both are part of the cooked data.
+        void setOptimizeIndexOrder(bool value) { optimizeIndices = value; }
+        void setOptimizeOverdraw(bool value) { optimizeOverdraw = value; }
+
+        // Headless loads only read what collision and visibility need and never call GL,
+        // so they work in processes without a GL context (dedicated servers, batch tools)
+        void setHeadless(bool value) { headless = value; }
+        bool isHeadless() const { return headless; }
+
+        const Planes& getPlanes() const { return planes; }
+        const Nodes& getNodes() const { return nodes; }
+        const Leaves& getLeaves() const { return leaves; }
+        const Brushes& getBrushes() const { return brushes; }
+        const BrushSides& getBrushSides() const { return brushsides; }
+        const IndexedData& getLeafBrushes() const { return leafBrushes; }
+        const Textures& getTextures() const { return textures; }
+        const PotentiallyVisibleSet& getPVS() const { return pvs; }
+        const Entities& getEntities() const { return entities; }
+        const Models& getModels() const { return models; }
+
+        // Lighting for dynamic objects, empty in headless loads and maps without a light grid
+        const LightGrid& getLightGrid() const { return lightGrid; }
+        const Billboards& getBillboards() const { return billboards; }
 
     private:
         Header header;
         LumpData lumps[static_cast<int>(LUMPS::MAXLUMPS)];
 
+        std::string filename;
+        LoadMode loadMode = LoadMode::Streamed;
+        bool validateLumps = false;     // Run each element's validate() right after decoding it
+        bool useMapCache = true;        // Read/write the cooked geometry next to the .bsp
+        bool headless = false;          // Skip render lumps, tessellation and every GL call
+        VertexFormat vertexFormat;
+        bool optimizeIndices = true;
+        bool optimizeOverdraw = false;
+        MapCache mapCache;
+        MappedFile mappedFile;  // Backs the lump views in MemoryMapped mode, must outlive them
+
+        std::thread loadThread;
+        std::atomic<LoadState> loadState{ LoadState::Idle };
+        std::atomic<float> loadProgress{ 0.0f };
+        std::atomic<const char*> loadStage{ "" };
+
+        // Geometry built on the CPU and not yet in GL buffers, it views cookedGeometry or mapCache
+        struct PendingUpload {
+            LumpView<unsigned char> faceVertexData;
+            LumpView<GLuint> faceIndexData;
+            LumpView<unsigned char> patchVertexData;
+            LumpView<GLuint> patchIndexData;
+            LumpView<GLuint> patchLodIndexData;
+            size_t uploadedBytes = 0;
+            bool buffersCreated = false;
+        };
+        CookedGeometry cookedGeometry;
+        PendingUpload pendingUpload;
+
         Vertices                vertices;
         Faces                   faces;
         Textures                textures;
@@ -63,28 +235,115 @@ namespace BSP {
         IndexedData             indices;
         IndexedData             leafFaces;
         IndexedData             leafBrushes;
+        Entities                entities;
+        Models                  models;
+        LightVolumes            lightVolumes;
+        LightGrid               lightGrid;
 
-        GLuint faceVAO, faceVBO;
-        GLuint patchVAO, patchVBO, patchEBO;
+        GLuint faceVAO = 0, faceVBO = 0, faceEBO = 0;
+        GLuint patchVAO = 0, patchVBO = 0, patchEBO = 0;
+        GLuint patchLodVAO = 0, patchLodEBO = 0;    // Shares patchVBO
         GLuint shaderProgram;
 
         int tesselationLevel;
 
         bool renderPolygonsAndMeshes = true;  // Flag para renderizar Polygons e Meshes
         bool renderPatches = true;            // Flag para renderizar Patches
+        bool renderBillboards = true;
+
+        PatchLod patchLod;
+        bool patchLodEnabled = false;
+        float patchLodError = 1.0f;
+        int viewportHeight = 720;
+        float patchLodScale = 0.0f;         // errorScale of PatchLod::select() for the frame, 0 draws the full level
+        std::vector<DrawRange> patchRanges; // Of the face being queued
+        int patchTriangles = 0;
+
+        Billboards billboards;              // Read the camera from the CameraUniforms block
+        float billboardSize = 16.0f;
 
-        std::unordered_map<int, int> faceToOffsetMap;
-        std::vector<PatchData> patches;
-        std::unordered_map<int, int> patchToOffsetMap;
-        std::unordered_map<int, GLuint> indexPatchToOffsetMap;
+        std::vector<DrawRange> faceRanges;  // Draw table, one entry per face
+
+        std::vector<Vec3f> faceCenters;     // Average of each face's vertices, for the depth of its sort key
+        std::vector<BoundingBox> faceBounds;    // Of each face's vertices, the control points for patches
+        float depthRange = 0.0f;            // Distance mapped to the farthest sort key depth
+
+        RenderQueue renderQueue;
+        RenderBackend renderBackend;
+        Vec3f cameraPosition;               // Given to the last drawLevel()
+        int drawCalls = 0;
+
+        bool frontToBack = false;
+        bool depthPrepass = false;
+        std::vector<int> nodeStack;             // Pending children of the tree walk
+        std::vector<unsigned int> faceVisits;   // Faces are shared by leaves, each one is queued once per walk
+        std::vector<int> unreferencedFaces;     // Faces of the world no leaf refers to, the walk adds them last
+        unsigned int visitStamp = 0;
+
+        // Two queries in flight, the older one is read while the newer one measures
+        bool measureFragments = false;
+        GLuint fragmentQueries[2] = { 0, 0 };
+        bool fragmentQueryPending[2] = { false, false };
+        int fragmentQuery = 0;              // The one the next color pass uses
+        bool fragmentQueryActive = false;
+        uint64_t fragmentCount = 0;
+
+        bool occlusionCulling = false;
+        OcclusionQueries occlusionQueries;      // One object per node, then one per leaf
+        std::vector<int> subtreeLeaves;         // Leaves with faces under each node
+        std::vector<int> walkedNodes;           // Nodes the last walk went into, parents before children
+        unsigned int occlusionFrame = 0;
+        int occludedLeaves = 0;
+        int occlusionQueryCount = 0;
+
+        bool softwareOcclusion = false;
+        OcclusionRasterizer occlusionRasterizer;
+        int softwareCulledLeaves = 0;
+        int softwareCulledPatches = 0;
+
+        std::vector<Mat4<float>> modelTransforms;   // Indexed by model, missing entries are identity
+        Mat4<float> viewProjection;
+        bool cullModels = false;                    // Set once a view projection was given
+        int culledModels = 0;                       // Submodels culled by the last drawLevel()
+
+        bool prepare(const std::string& filename);
+        bool readHeader(const std::string& filename);
+        bool readMappedHeader(const std::string& filename);
+        bool isHeaderValid() const;
+        void setLoadProgress(float progress, const char* stage);
+        void advanceLoadProgress(float progress, const char* stage);   // Never moves back, for pool tasks
+
+        template <typename OpenSource>
+        void decodeLumps(OpenSource openSource);
 
         void displayHeaderData(Header& header);
         void displayLumpData(LumpData(&lumps)[static_cast<int>(LUMPS::MAXLUMPS)]);
-        void drawFace(int faceIndex);
+        bool queueModel(int modelIndex, const Mat4<float>& transform);
+        void queueFaces(int firstFace, int numOfFaces, const Mat4<float>& transform);
+        void queueWorldFrontToBack(const Mat4<float>& transform, bool occlusion, bool software);
+        bool queueFace(int faceIndex, int transformIndex, uint32_t depth);
+        void submitRenderQueue();
+        void beginFragmentQuery();
+        void endFragmentQuery();
+
+        void initializeOcclusion();
+        void initializeSubtreeLeaves();
+        void requestOcclusionQuery(int object, const Vec3i& min, const Vec3i& max);
+        void revealSubtree(int node);
+        void pullUpOcclusion();
 
-        void initializeBezierPatches();
-        void initializeFaces();
-        void initializeQuadraticPatches(PatchData& patchData, const Face& face, int tesselationLevel);
+        void initializeLightGrid();
+        void initializeFaceCenters();
+        void initializeUnreferencedFaces();
+        void initializeGeometry();
+        void initializeBezierPatches(CookedGeometry& geometry);
+        void initializeFaces(CookedGeometry& geometry);
+        void optimizeIndexOrder(CookedGeometry& geometry);
+        void createGeometryBuffers(bool uploadData);
+        void deleteGeometryBuffers();
+        void releasePreviousLoad();
+        bool uploadGeometrySlice(size_t budgetBytes);
+        void releasePendingGeometry();
 
         void setTesselationLevel(int level);
         void debugVBO(GLuint vbo, GLsizei size);
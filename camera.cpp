@@ -20,23 +20,28 @@ Vec3<float> Camera::getRight() const {
 // Setters
 void Camera::setPosition(const Vec3<float>& newPosition) {
     position = newPosition;
+    viewDirty = true;
 }
 
 void Camera::setForward(const Vec3<float>& newForward) { // Implementado
     forward = newForward;
+    viewDirty = true;
 }
 
 void Camera::setUp(const Vec3<float>& newUp) { // Implementado
     up = newUp;
+    viewDirty = true;
 }
 
 void Camera::setRight(const Vec3<float>& newRight) { // Implementado
     right = newRight;
+    viewDirty = true;
 }
 
 // Translation and rotation
 void Camera::translate(const Vec3<float>& translation) {
     position = position + translation;
+    viewDirty = true;
 }
 
 void Camera::rotate(float angle, const Vec3<float>& axis) {
@@ -51,6 +56,7 @@ void Camera::rotate(float angle, const Vec3<float>& axis) {
 
     // Update the right vector
     right = forward.cross(up).normalize();
+    viewDirty = true;
 }
 
 void Camera::lookAt(const Vec3<float>& target) {
@@ -58,6 +64,7 @@ void Camera::lookAt(const Vec3<float>& target) {
     up = Vec3f(0.0f, 1.0f, 0.0f);
     right = forward.cross(up).normalize();
     up = right.cross(forward).normalize();
+    viewDirty = true;
 
     updateViewMatrix();
 }
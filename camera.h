@@ -28,10 +28,17 @@ public:
     void rotate(float angle, const Vec3<float>& axis);
     void lookAt(const Vec3<float>& target);
 
+    // Changes every time the view or projection matrix is recomputed, so users of the matrices
+    // (like CameraUniforms) can tell when they are stale
+    unsigned int getRevision() const { return revision; }
+
 protected:
     // Protected attributes for position and orientation
     Vec3<float> position;
     Vec3<float> forward;
     Vec3<float> up;
     Vec3<float> right;
+
+    bool viewDirty = true;      // Set by every change of position or orientation
+    unsigned int revision = 0;
 };
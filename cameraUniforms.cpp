@@ -0,0 +1,54 @@
+#include <cstring>
+
+#include "cameraUniforms.h"
+#include "glStateCache.h"
+
+CameraUniforms::~CameraUniforms() {
+    if (buffer != 0)
+        glDeleteBuffers(1, &buffer);
+}
+
+void CameraUniforms::create() {
+    if (buffer != 0)
+        return;
+
+    glGenBuffers(1, &buffer);
+
+    GLStateCache& state = GLStateCache::shared();
+    state.bindBuffer(GL_UNIFORM_BUFFER, buffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(Block), nullptr, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, BINDING, buffer);
+}
+
+bool CameraUniforms::update(const Camera& camera) {
+    if (buffer == 0 || (uploaded && camera.getRevision() == uploadedRevision))
+        return false;
+
+    Mat4<float> view = camera.getViewMatrix();
+    Mat4<float> projection = camera.getProjectionMatrix();
+    Mat4<float> viewProjection = projection * view;
+    Vec3<float> position = camera.getPosition();
+
+    Block block;
+    std::memcpy(block.view, view.transpose().getData(), sizeof(block.view));
+    std::memcpy(block.projection, projection.transpose().getData(), sizeof(block.projection));
+    std::memcpy(block.viewProjection, viewProjection.transpose().getData(), sizeof(block.viewProjection));
+    block.position[0] = position.x();
+    block.position[1] = position.y();
+    block.position[2] = position.z();
+    block.position[3] = 1.0f;
+
+    GLStateCache::shared().bindBuffer(GL_UNIFORM_BUFFER, buffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(Block), &block);
+
+    uploadedRevision = camera.getRevision();
+    uploaded = true;
+    uploads++;
+    return true;
+}
+
+void CameraUniforms::bindProgram(GLuint program) {
+    GLuint blockIndex = glGetUniformBlockIndex(program, "Camera");
+    if (blockIndex != GL_INVALID_INDEX)
+        glUniformBlockBinding(program, blockIndex, BINDING);
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "GL_Utils.h"
+#include "camera.h"
+
+// GLSL declaration of the block, to paste into a shader source right after the #version line
+#define CAMERA_UNIFORM_BLOCK \
+    "layout (std140) uniform Camera {\n" \
+    "   mat4 view;\n" \
+    "   mat4 projection;\n" \
+    "   mat4 viewProjection;\n" \
+    "   vec4 cameraPosition;\n" \
+    "};\n"
+
+// Camera matrices in one uniform buffer shared by every program that declares CAMERA_UNIFORM_BLOCK.
+// The buffer is rewritten at most once per camera change, no matter how many programs read it.
+class CameraUniforms {
+public:
+    // Binding point of the block
+    static const GLuint BINDING = 0;
+
+    // std140 layout of the block, the matrices column-major like GLSL expects them
+    struct Block {
+        float view[16];
+        float projection[16];
+        float viewProjection[16];
+        float position[4];      // w is 1
+    };
+
+    CameraUniforms() = default;
+    ~CameraUniforms();
+
+    CameraUniforms(const CameraUniforms&) = delete;
+    CameraUniforms& operator=(const CameraUniforms&) = delete;
+
+    // Create the buffer and attach it to BINDING
+    void create();
+
+    // Upload the camera's matrices if they changed since the last upload, returns true when it did.
+    // Call after the camera's update*Matrix() for the frame.
+    bool update(const Camera& camera);
+
+    // Point the program's "Camera" block to BINDING, programs without the block are left alone
+    static void bindProgram(GLuint program);
+
+    int getUploadCount() const { return uploads; }
+
+private:
+    GLuint buffer = 0;
+    unsigned int uploadedRevision = 0;
+    bool uploaded = false;
+    int uploads = 0;
+};
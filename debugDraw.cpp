@@ -0,0 +1,214 @@
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+#include "debugDraw.h"
+#include "glStateCache.h"
+#include "cameraUniforms.h"
+
+static const char* vertexShaderSource = "#version 330 core\n"
+    CAMERA_UNIFORM_BLOCK
+    "layout (location = 0) in vec3 aPos;\n"
+    "layout (location = 1) in vec4 aColor;\n"
+    "out vec4 color;\n"
+    "void main()\n"
+    "{\n"
+    "   gl_Position = viewProjection * vec4(aPos, 1.0);\n"
+    "   color = aColor;\n"
+    "}\0";
+
+static const char* fragmentShaderSource = "#version 330 core\n"
+    "in vec4 color;\n"
+    "out vec4 FragColor;\n"
+    "void main()\n"
+    "{\n"
+    "   FragColor = color;\n"
+    "}\n\0";
+
+// Triangle list of a unit sphere around the origin, built on first use
+static const std::vector<Vec3f>& unitSphere() {
+    static std::vector<Vec3f> triangles;
+    if (!triangles.empty())
+        return triangles;
+
+    const int sectors = 16;     // Around the vertical axis
+    const int stacks = 8;       // From pole to pole
+    const float pi = 3.14159265359f;
+
+    auto point = [&](int stack, int sector) {
+        float theta = stack * pi / stacks;
+        float phi = sector * 2.0f * pi / sectors;
+        return Vec3f(std::cos(phi) * std::sin(theta), std::cos(theta), std::sin(phi) * std::sin(theta));
+    };
+
+    for (int i = 0; i < stacks; i++) {
+        for (int j = 0; j < sectors; j++) {
+            Vec3f a = point(i, j), b = point(i + 1, j), c = point(i, j + 1), d = point(i + 1, j + 1);
+
+            // The rows at the poles collapse to one point, they only need one triangle per sector
+            if (i != 0) {
+                triangles.push_back(a);
+                triangles.push_back(b);
+                triangles.push_back(c);
+            }
+            if (i != stacks - 1) {
+                triangles.push_back(c);
+                triangles.push_back(b);
+                triangles.push_back(d);
+            }
+        }
+    }
+
+    return triangles;
+}
+
+DebugDraw::~DebugDraw() {
+    if (vao == 0)
+        return;
+
+    glDeleteVertexArrays(1, &vao);
+    glDeleteBuffers(1, &vbo);
+    GLStateCache::shared().forgetProgram(program);
+    glDeleteProgram(program);
+}
+
+void DebugDraw::create() {
+    if (vao != 0)
+        return;
+
+    GLStateCache& state = GLStateCache::shared();
+
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(1, &vbo);
+
+    // The storage is allocated by the first flush that has something to draw
+    state.bindVertexArray(vao);
+    state.bindBuffer(GL_ARRAY_BUFFER, vbo);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, position));
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), (void*)offsetof(Vertex, color));
+    glEnableVertexAttribArray(1);
+    state.bindVertexArray(0);
+
+    GLuint vertexShader = compileShader(GL_VERTEX_SHADER, vertexShaderSource, "Debug draw vertex shader");
+    GLuint fragmentShader = compileShader(GL_FRAGMENT_SHADER, fragmentShaderSource, "Debug draw fragment shader");
+
+    program = linkProgram(vertexShader, fragmentShader, "Debug draw shader program");
+
+    CameraUniforms::bindProgram(program);
+
+    checkGLError("DebugDraw create");
+}
+
+void DebugDraw::toBytes(const Vec3f& color, unsigned char bytes[4]) {
+    for (int i = 0; i < 3; i++)
+        bytes[i] = static_cast<unsigned char>(std::min(1.0f, std::max(0.0f, color[i])) * 255.0f + 0.5f);
+    bytes[3] = 255;
+}
+
+void DebugDraw::push(std::vector<Vertex>& stream, const Vec3f& position, const unsigned char color[4]) {
+    Vertex vertex;
+    for (int i = 0; i < 3; i++)
+        vertex.position[i] = position[i];
+    std::copy(color, color + 4, vertex.color);
+    stream.push_back(vertex);
+}
+
+void DebugDraw::line(const Vec3f& a, const Vec3f& b, const Vec3f& color) {
+    unsigned char bytes[4];
+    toBytes(color, bytes);
+
+    push(lines, a, bytes);
+    push(lines, b, bytes);
+}
+
+void DebugDraw::triangle(const Vec3f& a, const Vec3f& b, const Vec3f& c, const Vec3f& color) {
+    unsigned char bytes[4];
+    toBytes(color, bytes);
+
+    push(triangles, a, bytes);
+    push(triangles, b, bytes);
+    push(triangles, c, bytes);
+}
+
+void DebugDraw::box(const Vec3f& min, const Vec3f& max, const Vec3f& color) {
+    unsigned char bytes[4];
+    toBytes(color, bytes);
+
+    // Corner i takes max on the axes whose bit is set, like BoundingBox::corner()
+    Vec3f corners[8];
+    for (int i = 0; i < 8; i++)
+        corners[i] = Vec3f(i & 1 ? max.x() : min.x(), i & 2 ? max.y() : min.y(), i & 4 ? max.z() : min.z());
+
+    // Every edge joins two corners that differ in one bit
+    lines.reserve(lines.size() + 24);
+    for (int i = 0; i < 8; i++) {
+        for (int bit = 1; bit < 8; bit <<= 1) {
+            if (i & bit)
+                continue;
+            push(lines, corners[i], bytes);
+            push(lines, corners[i | bit], bytes);
+        }
+    }
+}
+
+void DebugDraw::sphere(const Vec3f& center, float radius, const Vec3f& color) {
+    unsigned char bytes[4];
+    toBytes(color, bytes);
+
+    const std::vector<Vec3f>& unit = unitSphere();
+    triangles.reserve(triangles.size() + unit.size());
+    for (const Vec3f& point : unit)
+        push(triangles, center + point * radius, bytes);
+}
+
+int DebugDraw::flush() {
+    if (vao == 0 || (lines.empty() && triangles.empty())) {
+        clear();
+        return 0;
+    }
+
+    GLStateCache& state = GLStateCache::shared();
+
+    size_t lineBytes = lines.size() * sizeof(Vertex);
+    size_t triangleBytes = triangles.size() * sizeof(Vertex);
+    size_t needed = lineBytes + triangleBytes;
+
+    // Grow geometrically so a frame with a few more shapes doesn't reallocate again next frame
+    if (needed > capacity)
+        capacity = std::max(needed, capacity * 2);
+
+    // Orphan the old storage every frame, the driver hands out fresh memory instead of waiting for
+    // the draws of the previous frame to finish reading it
+    state.bindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, capacity, nullptr, GL_STREAM_DRAW);
+    if (lineBytes > 0)
+        glBufferSubData(GL_ARRAY_BUFFER, 0, lineBytes, lines.data());
+    if (triangleBytes > 0)
+        glBufferSubData(GL_ARRAY_BUFFER, lineBytes, triangleBytes, triangles.data());
+
+    state.useProgram(program);
+    state.bindVertexArray(vao);
+
+    int drawCalls = 0;
+    if (!lines.empty()) {
+        glDrawArrays(GL_LINES, 0, static_cast<GLsizei>(lines.size()));
+        drawCalls++;
+    }
+    if (!triangles.empty()) {
+        glDrawArrays(GL_TRIANGLES, static_cast<GLint>(lines.size()), static_cast<GLsizei>(triangles.size()));
+        drawCalls++;
+    }
+
+    state.bindVertexArray(0);
+    state.useProgram(0);
+
+    clear();
+    return drawCalls;
+}
+
+void DebugDraw::clear() {
+    // Keeps the capacity, the next frame queues about as much
+    lines.clear();
+    triangles.clear();
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <vector>
+
+#include "GL_Utils.h"
+#include "vector.h"
+#include "boundingBox.h"
+
+/*
+Immediate-mode debug shapes. Lines, triangles, boxes and spheres are queued from anywhere during
+the frame and flush() draws them with one draw per primitive type. Every shape goes into the same
+streaming buffer, which only grows, so queuing thousands of node bounds creates no GL objects.
+
+The program reads the camera from the CameraUniforms block.
+*/
+class DebugDraw {
+public:
+    // 16 bytes, in the layout of the vertex buffer
+    struct Vertex {
+        float position[3];
+        unsigned char color[4];     // RGBA
+    };
+
+    DebugDraw() = default;
+    ~DebugDraw();
+
+    DebugDraw(const DebugDraw&) = delete;
+    DebugDraw& operator=(const DebugDraw&) = delete;
+
+    // Compile the program and create the buffers, needs a GL context. Shapes queued before are kept.
+    void create();
+
+    // Colors are RGB in [0, 1]
+    void line(const Vec3f& a, const Vec3f& b, const Vec3f& color);
+    void triangle(const Vec3f& a, const Vec3f& b, const Vec3f& c, const Vec3f& color);
+
+    // Wireframe box, 12 lines
+    void box(const Vec3f& min, const Vec3f& max, const Vec3f& color);
+    void box(const BSP::BoundingBox& bounds, const Vec3f& color) { box(bounds.min, bounds.max, color); }
+
+    // Solid sphere, copied from a unit sphere that is only tessellated once
+    void sphere(const Vec3f& center, float radius, const Vec3f& color);
+
+    // Draw everything queued since the last flush, then forget it. Returns the number of GL draw
+    // calls made (0 to 2). Leaves no program or VAO bound.
+    int flush();
+    void clear();
+
+    size_t getLineVertexCount() const { return lines.size(); }
+    size_t getTriangleVertexCount() const { return triangles.size(); }
+    size_t getBufferCapacity() const { return capacity; }      // In bytes
+
+private:
+    std::vector<Vertex> lines;
+    std::vector<Vertex> triangles;
+
+    GLuint vao = 0;
+    GLuint vbo = 0;
+    GLuint program = 0;
+    size_t capacity = 0;
+
+    static void push(std::vector<Vertex>& stream, const Vec3f& position, const unsigned char color[4]);
+    static void toBytes(const Vec3f& color, unsigned char bytes[4]);
+};
@@ -0,0 +1,45 @@
+#include "drawBatch.h"
+
+namespace BSP {
+    void DrawBatch::clear() {
+        counts.clear();
+        offsets.clear();
+        baseVertices.clear();
+        hasBaseVertex = false;
+        lastEnd = -1;
+    }
+
+    void DrawBatch::add(const DrawRange& range) {
+        if (range.count <= 0) {
+            return;
+        }
+
+        if (range.first == lastEnd && range.baseVertex == baseVertices.back()) {
+            counts.back() += range.count;
+        }
+        else {
+            counts.push_back(range.count);
+            offsets.push_back(reinterpret_cast<const void*>(range.first * sizeof(GLuint)));
+            baseVertices.push_back(range.baseVertex);
+            hasBaseVertex = hasBaseVertex || range.baseVertex != 0;
+        }
+
+        lastEnd = range.first + range.count;
+    }
+
+    int DrawBatch::submit() const {
+        if (counts.empty()) {
+            return 0;
+        }
+
+        if (hasBaseVertex) {
+            glMultiDrawElementsBaseVertex(GL_TRIANGLES, counts.data(), GL_UNSIGNED_INT,
+                offsets.data(), size(), baseVertices.data());
+        }
+        else {
+            glMultiDrawElements(GL_TRIANGLES, counts.data(), GL_UNSIGNED_INT, offsets.data(), size());
+        }
+
+        return 1;
+    }
+}
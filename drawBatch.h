@@ -0,0 +1,37 @@
+#pragma once
+
+#include <vector>
+
+#include "GL_Utils.h"
+#include "drawRange.h"
+
+namespace BSP {
+    /*
+    Index ranges that share a VAO and every other piece of GL state (a state bucket), submitted
+    together with one glMultiDrawElements(BaseVertex) call instead of one draw per face.
+
+    The arrays are kept between frames, so collecting a frame's faces does not allocate once they
+    have grown to the largest batch.
+    */
+    class DrawBatch {
+    public:
+        void clear();
+
+        // Ranges following the previous one in the element buffer with the same base vertex are
+        // merged into it, ranges without indices are skipped
+        void add(const DrawRange& range);
+
+        bool empty() const { return counts.empty(); }
+        int size() const { return static_cast<int>(counts.size()); }
+
+        // Draw every range with the bound VAO, returns the number of GL draw calls made (0 or 1)
+        int submit() const;
+
+    private:
+        std::vector<GLsizei> counts;
+        std::vector<const void*> offsets;   // Byte offsets into the element buffer
+        std::vector<GLint> baseVertices;
+        bool hasBaseVertex = false;         // glMultiDrawElements is enough while every base vertex is 0
+        int lastEnd = -1;                   // One past the last index of the last range
+    };
+}
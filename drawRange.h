@@ -0,0 +1,10 @@
+#pragma once
+
+namespace BSP {
+    // Where a face lives in the cooked buffers
+    struct DrawRange {
+        int first;          // First index in the face (polygons and meshes) or patch element buffer
+        int count;          // Number of indices, 0 when the face is not drawn
+        int baseVertex;     // Added to every index (polygons and meshes), 0 for patches
+    };
+}
@@ -0,0 +1,243 @@
+#include <algorithm>
+#include <cstdlib>
+#include <numeric>
+
+#include "entities.h"
+#include "utils.h"
+
+namespace BSP {
+    // The lump is null terminated on disk, the terminator is not part of the text
+    static std::string_view trimTerminator(std::string_view text) {
+        size_t end = text.find('\0');
+        return end == std::string_view::npos ? text : text.substr(0, end);
+    }
+
+    std::string_view Entity::get(std::string_view key) const {
+        for (const EntityPair& pair : pairs) {
+            if (pair.key == key) {
+                return pair.value;
+            }
+        }
+        return std::string_view();
+    }
+
+    bool Entity::has(std::string_view key) const {
+        for (const EntityPair& pair : pairs) {
+            if (pair.key == key) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Parse up to count floats separated by spaces, the value is not null terminated so it is copied first
+    static bool parseFloats(std::string_view value, float* out, int count) {
+        char buffer[128];
+        if (value.empty() || value.size() >= sizeof(buffer)) {
+            return false;
+        }
+        std::memcpy(buffer, value.data(), value.size());
+        buffer[value.size()] = '\0';
+
+        char* cursor = buffer;
+        for (int i = 0; i < count; i++) {
+            char* end = nullptr;
+            out[i] = std::strtof(cursor, &end);
+            if (end == cursor) {
+                return false;
+            }
+            cursor = end;
+        }
+        return true;
+    }
+
+    bool Entity::getFloat(std::string_view key, float& out) const {
+        return parseFloats(get(key), &out, 1);
+    }
+
+    bool Entity::getVector(std::string_view key, Vec3f& out) const {
+        float values[3];
+        if (!parseFloats(get(key), values, 3)) {
+            return false;
+        }
+        out = Vec3f(values[0], values[1], values[2]);
+        return true;
+    }
+
+    bool Entity::getOrigin(Vec3f& out) const {
+        Vec3f origin;
+        if (!getVector("origin", origin)) {
+            return false;
+        }
+
+        // Same conversion as the spatial lumps get in Transcode
+        out = Vec3f(origin.x(), origin.z(), -origin.y());
+        return true;
+    }
+
+    void Entities::load(std::ifstream& file, LumpData& lumpData) {
+        ownedText.resize(lumpData.length > 0 ? lumpData.length : 0);
+
+        file.seekg(lumpData.offset, std::ios::beg);
+        file.read(&ownedText[0], ownedText.size());
+
+        text = trimTerminator(ownedText);
+        parse();
+    }
+
+    void Entities::load(const MappedFile& file, LumpData& lumpData) {
+        ownedText.clear();
+
+        LumpView<char> lump = file.view<char>(lumpData);
+        text = trimTerminator(std::string_view(lump.data() ? lump.data() : "", lump.size()));
+        parse();
+    }
+
+    // Whitespace and // comments between tokens
+    static size_t skipWhitespace(std::string_view text, size_t cursor) {
+        while (cursor < text.size()) {
+            if (static_cast<unsigned char>(text[cursor]) <= ' ') {
+                cursor++;
+            }
+            else if (text.compare(cursor, 2, "//") == 0) {
+                cursor = text.find('\n', cursor);
+                if (cursor == std::string_view::npos) {
+                    return text.size();
+                }
+            }
+            else {
+                break;
+            }
+        }
+        return cursor;
+    }
+
+    // Quoted string starting at cursor, cursor is moved past the closing quote
+    static bool readQuoted(std::string_view text, size_t& cursor, std::string_view& out) {
+        if (cursor >= text.size() || text[cursor] != '"') {
+            return false;
+        }
+
+        size_t end = text.find('"', cursor + 1);
+        if (end == std::string_view::npos) {
+            return false;
+        }
+
+        out = text.substr(cursor + 1, end - cursor - 1);
+        cursor = end + 1;
+        return true;
+    }
+
+    void Entities::parse() {
+        pairs.clear();
+        entities.clear();
+
+        // Every pair has 4 quotes and every entity one brace, so one reservation holds the whole lump
+        // and the views handed out below never move
+        pairs.reserve(std::count(text.begin(), text.end(), '"') / 4);
+        entities.reserve(std::count(text.begin(), text.end(), '{'));
+
+        size_t cursor = skipWhitespace(text, 0);
+        while (cursor < text.size()) {
+            if (text[cursor] != '{') {
+                std::cout << "Entity lump: expected '{' at offset " << cursor << ", ignoring the rest" << std::endl;
+                break;
+            }
+            cursor = skipWhitespace(text, cursor + 1);
+
+            size_t first = pairs.size();
+            bool closed = false;
+
+            while (cursor < text.size()) {
+                if (text[cursor] == '}') {
+                    cursor = skipWhitespace(text, cursor + 1);
+                    closed = true;
+                    break;
+                }
+
+                EntityPair pair;
+                if (!readQuoted(text, cursor, pair.key)) {
+                    break;
+                }
+                cursor = skipWhitespace(text, cursor);
+                if (!readQuoted(text, cursor, pair.value)) {
+                    break;
+                }
+                cursor = skipWhitespace(text, cursor);
+
+                pairs.push_back(pair);
+            }
+
+            if (!closed) {
+                std::cout << "Entity lump: malformed entity " << entities.size() << " at offset " << cursor << ", ignoring the rest" << std::endl;
+                pairs.resize(first);
+                break;
+            }
+
+            entities.emplace_back(LumpView<EntityPair>(pairs.data() + first, pairs.size() - first));
+        }
+
+        byClassname.build(entities, "classname");
+        byTargetname.build(entities, "targetname");
+    }
+
+    void Entities::NameIndex::build(const std::vector<Entity>& all, std::string_view key) {
+        entities.clear();
+        names.clear();
+
+        for (int i = 0; i < static_cast<int>(all.size()); i++) {
+            if (all[i].has(key)) {
+                entities.push_back(i);
+            }
+        }
+
+        std::stable_sort(entities.begin(), entities.end(), [&all, key](int a, int b) {
+            return all[a].get(key) < all[b].get(key);
+        });
+
+        names.reserve(entities.size());
+        for (int entity : entities) {
+            names.push_back(all[entity].get(key));
+        }
+    }
+
+    LumpView<int> Entities::NameIndex::find(std::string_view name) const {
+        auto range = std::equal_range(names.begin(), names.end(), name);
+        size_t first = range.first - names.begin();
+        return LumpView<int>(entities.data() + first, range.second - range.first);
+    }
+
+    LumpView<int> Entities::findByClassname(std::string_view classname) const {
+        return byClassname.find(classname);
+    }
+
+    LumpView<int> Entities::findByTargetname(std::string_view targetname) const {
+        return byTargetname.find(targetname);
+    }
+
+    const Entity* Entities::findFirstByClassname(std::string_view classname) const {
+        LumpView<int> found = findByClassname(classname);
+        return found.empty() ? nullptr : &entities[found[0]];
+    }
+
+    const Entity* Entities::findFirstByTargetname(std::string_view targetname) const {
+        LumpView<int> found = findByTargetname(targetname);
+        return found.empty() ? nullptr : &entities[found[0]];
+    }
+
+    void Entities::validate() {
+        warning_assert(!text.empty(), "Entity lump is empty.");
+        warning_assert(!entities.empty(), "Entity lump has no entities.");
+        warning_assert(findFirstByClassname("worldspawn") != nullptr, "Entity lump has no worldspawn.");
+    }
+
+    void Entities::displayData() const {
+        std::cout << "Entity Data:" << std::endl;
+        for (size_t i = 0; i < entities.size(); i++) {
+            std::cout << "Entity " << i << ":" << std::endl;
+            for (const EntityPair& pair : entities[i].getPairs()) {
+                std::cout << "  " << pair.key << " = " << pair.value << std::endl;
+            }
+        }
+    }
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "BSPElement.h"
+
+/*
+The entity lump is a single block of text describing every entity of the map (spawn points, lights,
+triggers, doors...), each one as a list of key/value pairs between braces:
+
+{
+"classname" "info_player_deathmatch"
+"origin" "-64 128 24"
+}
+
+In MemoryMapped mode the text is viewed in place, otherwise it is copied into an owned string.
+Either way that text is the only storage for the strings: parsing is a single pass that records
+string_views into it, and all the pairs of the map live in one array, so no key or value is ever
+allocated on its own.
+*/
+
+namespace BSP {
+    struct EntityPair {
+        std::string_view key;
+        std::string_view value;
+    };
+
+    class Entity {
+    public:
+        Entity() = default;
+        explicit Entity(LumpView<EntityPair> pairs) : pairs(pairs) {}
+
+        // Value of key, empty when the entity does not have it
+        std::string_view get(std::string_view key) const;
+        bool has(std::string_view key) const;
+
+        std::string_view getClassname() const { return get("classname"); }
+        std::string_view getTargetname() const { return get("targetname"); }
+
+        // Numeric values, false (and out untouched) when the key is missing or malformed
+        bool getFloat(std::string_view key, float& out) const;
+        bool getVector(std::string_view key, Vec3f& out) const;
+
+        // "origin" converted to the Y-up space the vertices are loaded in
+        bool getOrigin(Vec3f& out) const;
+
+        LumpView<EntityPair> getPairs() const { return pairs; }
+
+    private:
+        LumpView<EntityPair> pairs;     // Slice of Entities::pairs
+    };
+
+    class Entities {
+    public:
+        Entities() = default;
+
+        // Entity holds pointers into the pair array and the text, so the container can't be copied
+        Entities(const Entities&) = delete;
+        Entities& operator=(const Entities&) = delete;
+
+        // Read the entity text from file
+        void load(std::ifstream& file, LumpData& lumpData);
+
+        // Read the entity text from a mapped file, the text is viewed in place
+        void load(const MappedFile& file, LumpData& lumpData);
+
+        // The text without the terminating null character
+        std::string_view getText() const { return text; }
+
+        size_t size() const { return entities.size(); }
+        const Entity& operator[](size_t index) const { return entities[index]; }
+        const std::vector<Entity>& getEntities() const { return entities; }
+
+        // Indices of every entity with that classname / targetname, in lump order
+        LumpView<int> findByClassname(std::string_view classname) const;
+        LumpView<int> findByTargetname(std::string_view targetname) const;
+
+        // First entity with that classname / targetname, nullptr when there is none
+        const Entity* findFirstByClassname(std::string_view classname) const;
+        const Entity* findFirstByTargetname(std::string_view targetname) const;
+
+        void validate();
+        void displayData() const;
+
+    private:
+        std::string ownedText;              // Copy of the lump, used by streamed loads
+        std::string_view text;              // Either ownedText or a view into a MappedFile
+
+        std::vector<EntityPair> pairs;      // Pairs of every entity, back to back
+        std::vector<Entity> entities;
+
+        // Entities sorted by the value of one key, stable so lump order is kept within a name
+        struct NameIndex {
+            std::vector<std::string_view> names;
+            std::vector<int> entities;
+
+            void build(const std::vector<Entity>& entities, std::string_view key);
+            LumpView<int> find(std::string_view name) const;
+        };
+
+        NameIndex byClassname;
+        NameIndex byTargetname;
+
+        void parse();
+    };
+}
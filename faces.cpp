@@ -1,9 +1,33 @@
 #include "Faces.h"
+#include "transcode.h"
 #include "utils.h"
 
 namespace BSP {
+    /*
+    What the lightmap fields hold depends on the face type:
+    - polygons and meshes: lightmap origin and the two lightmap axes, all spatial
+    - patches: lightMapVecs are the bounds of the patch group (used for the level of detail)
+    - billboards (flares): lightMapPos is the origin and lightMapVecs[0] the flare color, left as is
+    Every field is followed by at least 4 more bytes of the face, so the wide helpers are always safe.
+    */
+    void Faces::transcode(const Face* source, Face* destination, size_t count) {
+        Transcode::records(source, destination, count, [](Face& face, bool) {
+            Transcode::vectorWide(&face.lightMapPos[0]);
+
+            if (face.type == FACE_PATCH) {
+                Transcode::boxWide(&face.lightMapVecs[0][0], &face.lightMapVecs[1][0]);
+            }
+            else if (face.type != FACE_BBOARD) {
+                Transcode::vectorWide(&face.lightMapVecs[0][0]);
+                Transcode::vectorWide(&face.lightMapVecs[1][0]);
+            }
+
+            Transcode::vectorWide(&face.normal[0]);
+        });
+    }
+
     void Faces::validate() {
-        for (const auto& face : elements) {
+        for (const auto& face : getData()) {
             warning_assert(face.getTextureID() >= 0, "TextureID is negative.");
 
             warning_assert(face.getEffect() >= -1, "Effect is less than -1.");
@@ -39,7 +63,7 @@ namespace BSP {
     void Faces::displayData() const {
         std::cout << "Displaying Face Data:" << std::endl;
         int count = 1;
-        for (const auto& face : elements) {
+        for (const auto& face : getData()) {
             std::cout << "Face " << count << ": " << face << std::endl;
             count++;
         }
@@ -49,6 +49,8 @@ namespace BSP {
         ~Face() = default;
 
     private:
+        friend class Faces;
+
         int textureID;
         int effect;
         int type;
@@ -69,5 +71,9 @@ namespace BSP {
     public:
         void validate() override;
         void displayData() const override;
+
+    protected:
+        bool isTranscoded() const override { return true; }
+        void transcode(const Face* source, Face* destination, size_t count) override;
     };
 }
\ No newline at end of file
@@ -0,0 +1,170 @@
+#include <algorithm>
+
+#include "glStateCache.h"
+
+GLStateCache::GLStateCache() {
+    invalidate();
+}
+
+bool GLStateCache::changes(bool differs) {
+    if (differs) {
+        counters.issued++;
+    }
+    else {
+        counters.elided++;
+    }
+    return differs;
+}
+
+void GLStateCache::useProgram(GLuint newProgram) {
+    if (changes(program != newProgram)) {
+        glUseProgram(newProgram);
+        program = newProgram;
+    }
+}
+
+void GLStateCache::bindVertexArray(GLuint newVertexArray) {
+    if (changes(vertexArray != newVertexArray)) {
+        glBindVertexArray(newVertexArray);
+        vertexArray = newVertexArray;
+
+        // The element buffer binding belongs to the VAO
+        buffers.erase(std::remove_if(buffers.begin(), buffers.end(),
+            [](const Binding& binding) { return binding.target == GL_ELEMENT_ARRAY_BUFFER; }), buffers.end());
+    }
+}
+
+void GLStateCache::bindBuffer(GLenum target, GLuint buffer) {
+    auto known = std::find_if(buffers.begin(), buffers.end(),
+        [target](const Binding& binding) { return binding.target == target; });
+
+    if (changes(known == buffers.end() || known->object != buffer)) {
+        glBindBuffer(target, buffer);
+
+        if (known == buffers.end()) {
+            buffers.push_back(Binding{ target, buffer });
+        }
+        else {
+            known->object = buffer;
+        }
+    }
+}
+
+void GLStateCache::bindTexture(int unit, GLenum target, GLuint texture) {
+    if (unit < 0 || unit >= TEXTURE_UNITS) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(target, texture);
+        activeUnit = unit;
+        counters.issued += 2;
+        return;
+    }
+
+    Binding& bound = textures[unit];
+    if (!changes(bound.object == UNKNOWN || bound.target != target || bound.object != texture)) {
+        return;
+    }
+
+    // Part of the bind counted above, a unit that is already active is not a skipped call of its own
+    if (activeUnit != unit) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        activeUnit = unit;
+        counters.issued++;
+    }
+
+    glBindTexture(target, texture);
+    bound = Binding{ target, texture };
+}
+
+void GLStateCache::setCapability(GLenum capability, bool enabled) {
+    auto known = std::find_if(capabilities.begin(), capabilities.end(),
+        [capability](const Capability& state) { return state.capability == capability; });
+
+    if (changes(known == capabilities.end() || known->enabled != enabled)) {
+        if (enabled) {
+            glEnable(capability);
+        }
+        else {
+            glDisable(capability);
+        }
+
+        if (known == capabilities.end()) {
+            capabilities.push_back(Capability{ capability, enabled });
+        }
+        else {
+            known->enabled = enabled;
+        }
+    }
+}
+
+void GLStateCache::depthMask(bool enabled) {
+    if (changes(depthWrites != (enabled ? 1 : 0))) {
+        glDepthMask(enabled ? GL_TRUE : GL_FALSE);
+        depthWrites = enabled ? 1 : 0;
+    }
+}
+
+void GLStateCache::depthFunc(GLenum function) {
+    if (changes(depthFunction != function)) {
+        glDepthFunc(function);
+        depthFunction = function;
+    }
+}
+
+void GLStateCache::colorMask(bool enabled) {
+    if (changes(colorWrites != (enabled ? 1 : 0))) {
+        GLboolean value = enabled ? GL_TRUE : GL_FALSE;
+        glColorMask(value, value, value, value);
+        colorWrites = enabled ? 1 : 0;
+    }
+}
+
+void GLStateCache::blendFunc(GLenum source, GLenum destination) {
+    if (changes(!blendKnown || blendSource != source || blendDestination != destination)) {
+        glBlendFunc(source, destination);
+        blendSource = source;
+        blendDestination = destination;
+        blendKnown = true;
+    }
+}
+
+GLint GLStateCache::getUniformLocation(GLuint program, const char* name) {
+    std::unordered_map<std::string, GLint>& locations = uniformLocations[program];
+
+    auto cached = locations.find(name);
+    if (cached != locations.end()) {
+        counters.uniformHits++;
+        return cached->second;
+    }
+
+    counters.uniformLookups++;
+    GLint location = glGetUniformLocation(program, name);
+    locations.emplace(name, location);
+    return location;
+}
+
+void GLStateCache::invalidate() {
+    program = UNKNOWN;
+    vertexArray = UNKNOWN;
+    buffers.clear();
+    activeUnit = -1;
+    std::fill_n(textures, TEXTURE_UNITS, Binding{ GL_NONE, UNKNOWN });
+    capabilities.clear();
+    depthWrites = -1;
+    depthFunction = GL_NONE;
+    colorWrites = -1;
+    blendKnown = false;
+}
+
+void GLStateCache::forgetProgram(GLuint deletedProgram) {
+    uniformLocations.erase(deletedProgram);
+
+    // GL may hand the same name to a new program
+    if (program == deletedProgram) {
+        program = UNKNOWN;
+    }
+}
+
+GLStateCache& GLStateCache::shared() {
+    static GLStateCache cache;
+    return cache;
+}
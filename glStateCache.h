@@ -0,0 +1,81 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "GL_Utils.h"
+
+// Shadow copy of the GL state the renderer changes every frame. Each setter only reaches the driver
+// when the value differs from the last one set, and uniform locations are looked up once per program.
+// Code that changes state without going through the cache (uploads, debug helpers) has to call
+// invalidate() afterwards. Only use it from the thread that owns the GL context.
+class GLStateCache {
+public:
+    struct Counters {
+        size_t issued = 0;          // State calls that reached the driver
+        size_t elided = 0;          // State calls skipped because they would not change anything
+        size_t uniformLookups = 0;  // glGetUniformLocation calls made
+        size_t uniformHits = 0;     // Locations served from the cache
+    };
+
+    static const int TEXTURE_UNITS = 16;
+
+    GLStateCache();
+
+    void useProgram(GLuint program);
+    void bindVertexArray(GLuint vertexArray);
+    void bindBuffer(GLenum target, GLuint buffer);
+    void bindTexture(int unit, GLenum target, GLuint texture);
+    void setCapability(GLenum capability, bool enabled);
+    void depthMask(bool enabled);
+    void depthFunc(GLenum function);
+    void colorMask(bool enabled);     // All four channels at once
+    void blendFunc(GLenum source, GLenum destination);
+
+    GLint getUniformLocation(GLuint program, const char* name);
+
+    // Forget every cached binding, the next call of each kind goes to the driver
+    void invalidate();
+
+    // Drop what is cached about a program that is being deleted
+    void forgetProgram(GLuint program);
+
+    const Counters& getCounters() const { return counters; }
+    void resetCounters() { counters = Counters(); }
+
+    // Cache of the process' GL context
+    static GLStateCache& shared();
+
+private:
+    static const GLuint UNKNOWN = 0xFFFFFFFF;
+
+    struct Binding {
+        GLenum target;
+        GLuint object;
+    };
+
+    struct Capability {
+        GLenum capability;
+        bool enabled;
+    };
+
+    GLuint program = UNKNOWN;
+    GLuint vertexArray = UNKNOWN;
+    std::vector<Binding> buffers;               // Known bindings, by target
+    int activeUnit = -1;
+    Binding textures[TEXTURE_UNITS];            // One target per unit, UNKNOWN object when not known
+    std::vector<Capability> capabilities;       // Known glEnable/glDisable states
+    int depthWrites = -1;                       // -1 unknown, else 0 or 1
+    GLenum depthFunction = GL_NONE;             // GL_NONE when not known
+    int colorWrites = -1;                       // -1 unknown, else 0 or 1
+    GLenum blendSource = GL_NONE;
+    GLenum blendDestination = GL_NONE;
+    bool blendKnown = false;
+
+    std::unordered_map<GLuint, std::unordered_map<std::string, GLint>> uniformLocations;
+    Counters counters;
+
+    // Counts the call and returns true when it has to reach the driver
+    bool changes(bool differs);
+};
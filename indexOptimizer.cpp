@@ -0,0 +1,229 @@
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "indexOptimizer.h"
+#include "vector.h"
+
+namespace BSP {
+    CacheStats measureVertexCache(const GLuint* indices, size_t indexCount, int cacheSize) {
+        CacheStats stats;
+        stats.triangles = indexCount / 3;
+
+        std::vector<GLuint> cache(cacheSize);
+        int cached = 0;
+        int oldest = 0;
+
+        for (size_t i = 0; i < indexCount; i++) {
+            GLuint vertex = indices[i];
+            if (std::find(cache.begin(), cache.begin() + cached, vertex) != cache.begin() + cached) {
+                continue;
+            }
+
+            stats.misses++;
+            if (cached < cacheSize) {
+                cache[cached++] = vertex;
+            }
+            else {
+                cache[oldest] = vertex;
+                oldest = (oldest + 1) % cacheSize;
+            }
+        }
+
+        return stats;
+    }
+
+    static Vec3f positionOf(const unsigned char* vertexData, int stride, GLuint vertex) {
+        float position[3];
+        std::memcpy(position, vertexData + static_cast<size_t>(vertex) * stride, sizeof(position));
+        return Vec3f(position[0], position[1], position[2]);
+    }
+
+    // Sorts the clusters by how much they face away from the center of the list, outer surfaces first
+    static void sortClustersForOverdraw(std::vector<GLuint>& order, const std::vector<size_t>& clusterStarts,
+        const unsigned char* vertexData, int stride) {
+        struct Cluster {
+            size_t first;
+            size_t count;
+            float score;
+        };
+
+        size_t triangleCount = order.size() / 3;
+        std::vector<Cluster> clusters;
+        Vec3f center(0.0f, 0.0f, 0.0f);
+
+        for (size_t i = 0; i < clusterStarts.size(); i++) {
+            size_t first = clusterStarts[i];
+            size_t last = i + 1 < clusterStarts.size() ? clusterStarts[i + 1] : triangleCount;
+            clusters.push_back(Cluster{ first, last - first, 0.0f });
+        }
+
+        for (GLuint vertex : order) {
+            center = center + positionOf(vertexData, stride, vertex);
+        }
+        center = center * (1.0f / order.size());
+
+        for (Cluster& cluster : clusters) {
+            // Area weighted normal and centroid of the cluster
+            Vec3f normal(0.0f, 0.0f, 0.0f);
+            Vec3f centroid(0.0f, 0.0f, 0.0f);
+
+            for (size_t t = cluster.first; t < cluster.first + cluster.count; t++) {
+                Vec3f a = positionOf(vertexData, stride, order[t * 3]);
+                Vec3f b = positionOf(vertexData, stride, order[t * 3 + 1]);
+                Vec3f c = positionOf(vertexData, stride, order[t * 3 + 2]);
+
+                normal = normal + Vec3f(b - a).cross(c - a);
+                centroid = centroid + (a + b + c) * (1.0f / 3.0f);
+            }
+
+            centroid = centroid * (1.0f / cluster.count);
+            cluster.score = Vec3f(centroid - center).dot(normal);
+        }
+
+        std::stable_sort(clusters.begin(), clusters.end(),
+            [](const Cluster& a, const Cluster& b) { return a.score > b.score; });
+
+        std::vector<GLuint> sorted;
+        sorted.reserve(order.size());
+        for (const Cluster& cluster : clusters) {
+            sorted.insert(sorted.end(), order.begin() + cluster.first * 3, order.begin() + (cluster.first + cluster.count) * 3);
+        }
+        order.swap(sorted);
+    }
+
+    void optimizeIndexOrder(GLuint* indices, size_t indexCount, const unsigned char* vertexData, int stride,
+        bool reduceOverdraw, int cacheSize) {
+        size_t triangleCount = indexCount / 3;
+        if (triangleCount < 2) {
+            return;
+        }
+
+        // Work on indices relative to the lowest vertex, ranges of patches are absolute
+        GLuint firstVertex = *std::min_element(indices, indices + triangleCount * 3);
+        GLuint lastVertex = *std::max_element(indices, indices + triangleCount * 3);
+        size_t vertexCount = lastVertex - firstVertex + 1;
+
+        // Triangles using each vertex
+        std::vector<int> liveTriangles(vertexCount, 0);
+        for (size_t i = 0; i < triangleCount * 3; i++) {
+            liveTriangles[indices[i] - firstVertex]++;
+        }
+
+        std::vector<size_t> adjacencyStart(vertexCount + 1, 0);
+        for (size_t v = 0; v < vertexCount; v++) {
+            adjacencyStart[v + 1] = adjacencyStart[v] + liveTriangles[v];
+        }
+
+        std::vector<size_t> adjacency(triangleCount * 3);
+        std::vector<size_t> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+        for (size_t t = 0; t < triangleCount; t++) {
+            for (int corner = 0; corner < 3; corner++) {
+                adjacency[fill[indices[t * 3 + corner] - firstVertex]++] = t;
+            }
+        }
+
+        std::vector<int> cacheTime(vertexCount, 0);
+        std::vector<bool> emitted(triangleCount, false);
+        std::vector<GLuint> deadEnd;
+        std::vector<GLuint> candidates;
+        std::vector<GLuint> order;
+        std::vector<size_t> clusterStarts;
+        order.reserve(triangleCount * 3);
+
+        int time = cacheSize + 1;
+        size_t cursor = 0;
+        int fanning = 0;
+
+        // Vertex 0 may not be used by any triangle when the list has holes
+        while (fanning < static_cast<int>(vertexCount) && liveTriangles[fanning] == 0) {
+            fanning++;
+        }
+        clusterStarts.push_back(0);
+
+        while (fanning < static_cast<int>(vertexCount)) {
+            candidates.clear();
+
+            for (size_t a = adjacencyStart[fanning]; a < adjacencyStart[fanning + 1]; a++) {
+                size_t t = adjacency[a];
+                if (emitted[t]) {
+                    continue;
+                }
+
+                for (int corner = 0; corner < 3; corner++) {
+                    GLuint vertex = indices[t * 3 + corner] - firstVertex;
+                    order.push_back(vertex + firstVertex);
+                    deadEnd.push_back(vertex);
+                    candidates.push_back(vertex);
+                    liveTriangles[vertex]--;
+
+                    if (time - cacheTime[vertex] > cacheSize) {
+                        cacheTime[vertex] = time++;
+                    }
+                }
+                emitted[t] = true;
+            }
+
+            // Next fanning vertex: the candidate that stays longest in the cache after its fan
+            int next = -1;
+            int bestPriority = -1;
+            for (GLuint vertex : candidates) {
+                if (liveTriangles[vertex] <= 0) {
+                    continue;
+                }
+
+                int priority = 0;
+                if (time - cacheTime[vertex] + 2 * liveTriangles[vertex] <= cacheSize) {
+                    priority = time - cacheTime[vertex];
+                }
+                if (priority > bestPriority) {
+                    bestPriority = priority;
+                    next = static_cast<int>(vertex);
+                }
+            }
+
+            if (next < 0) {
+                // Dead end: a recently used vertex with triangles left, or else the next one in input order
+                while (!deadEnd.empty() && next < 0) {
+                    GLuint vertex = deadEnd.back();
+                    deadEnd.pop_back();
+                    if (liveTriangles[vertex] > 0) {
+                        next = static_cast<int>(vertex);
+                    }
+                }
+
+                while (next < 0 && cursor < vertexCount) {
+                    if (liveTriangles[cursor] > 0) {
+                        next = static_cast<int>(cursor);
+                    }
+                    cursor++;
+                }
+
+                // The cache is cold again, a new cluster starts here
+                if (next >= 0 && order.size() / 3 < triangleCount) {
+                    clusterStarts.push_back(order.size() / 3);
+                }
+            }
+
+            fanning = next < 0 ? static_cast<int>(vertexCount) : next;
+        }
+
+        CacheStats cacheOnly = measureVertexCache(order.data(), order.size(), cacheSize);
+
+        if (reduceOverdraw && clusterStarts.size() > 1) {
+            std::vector<GLuint> overdrawOrder = order;
+            sortClustersForOverdraw(overdrawOrder, clusterStarts, vertexData, stride);
+
+            CacheStats sorted = measureVertexCache(overdrawOrder.data(), overdrawOrder.size(), cacheSize);
+            if (sorted.misses <= cacheOnly.misses * 1.05f) {
+                order.swap(overdrawOrder);
+                cacheOnly = sorted;
+            }
+        }
+
+        // Never make a list worse than it was
+        if (cacheOnly.misses < measureVertexCache(indices, triangleCount * 3, cacheSize).misses) {
+            std::copy(order.begin(), order.end(), indices);
+        }
+    }
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+
+#include "GL_Utils.h"
+
+namespace BSP {
+    // Post-transform vertex cache the index order is optimized and measured for (FIFO, in vertices)
+    const int VERTEX_CACHE_SIZE = 16;
+
+    // Vertex cache misses of a set of draws, ACMR = misses per triangle
+    struct CacheStats {
+        size_t triangles = 0;
+        size_t misses = 0;
+
+        float acmr() const { return triangles ? static_cast<float>(misses) / triangles : 0.0f; }
+    };
+
+    // Misses of a FIFO cache of cacheSize vertices when drawing the triangle list in order
+    CacheStats measureVertexCache(const GLuint* indices, size_t indexCount, int cacheSize = VERTEX_CACHE_SIZE);
+
+    /*
+    Reorders the triangles of one triangle list in place for the post-transform vertex cache, with
+    Tipsify (Sander, Nehab and Barczak, "Fast Triangle Reordering for Vertex Locality and Reduced
+    Overdraw", 2007). Triangles keep their winding and stay inside the list, so the result can
+    replace the original range of a draw.
+
+    With reduceOverdraw the clusters Tipsify ends at cache flushes are also sorted so surfaces facing
+    away from the center of the list are drawn first, as long as the ACMR stays within 5% of the
+    cache-only order. That needs the positions: vertex i starts at vertexData + i * stride with
+    3 floats, like every VertexFormat.
+    */
+    void optimizeIndexOrder(GLuint* indices, size_t indexCount, const unsigned char* vertexData, int stride,
+        bool reduceOverdraw, int cacheSize = VERTEX_CACHE_SIZE);
+}
@@ -2,7 +2,7 @@
 
 // Defina a funo de operador de sada aqui
 std::ostream& operator<<(std::ostream& os, const IndexedData& indexedData) {
-    const std::vector<int>& values = indexedData.getValues();
+    LumpView<int> values = indexedData.getView();
 
     os << "IndexedData Values:\n";
 
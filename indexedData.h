@@ -3,10 +3,15 @@
 #include <fstream>
 #include <vector>
 #include <iostream>
+#include <cstring>
+
+#include "lumpView.h"
+#include "mappedFile.h"
 
 class IndexedData {
 private:
     std::vector<int> values;
+    LumpView<int> mapped;   // View into a MappedFile, used by zero-copy loads
 
 public:
     // Default constructor
@@ -24,6 +29,17 @@ public:
     const std::vector<int>& getValues() const { return values; }
     std::vector<int>& getValues() { return values; }
 
+    // Read-only access that works for both owned and mapped indices
+    LumpView<int> getView() const {
+        if (mapped.data() != nullptr) {
+            return mapped;
+        }
+        return LumpView<int>(values.data(), values.size());
+    }
+
+    size_t size() const { return getView().size(); }
+    int operator[](size_t index) const { return getView()[index]; }
+
     // Setter methods
     void setValues(const std::vector<int>& newValues) { values = newValues; }
 
@@ -31,6 +47,7 @@ public:
 
     // Load method
     void load(std::ifstream& file, int lumpLength, int lumpOffset) {
+        mapped = LumpView<int>();
 
         // Seek to the position in the file that stores the index information
         file.seekg(lumpOffset, std::ios::beg);
@@ -47,10 +64,16 @@ public:
         //std::cin.get();
     }
 
+    // Zero-copy load method, the indices are read straight from the mapping
+    void load(const BSP::MappedFile& file, int lumpLength, int lumpOffset) {
+        values.clear();
+        mapped = file.view<int>(BSP::LumpData{ lumpOffset, lumpLength });
+    }
+
     void displayData() const {
         int i = 0;
         std::cout << "Indexed Data: [ ";
-        for (const auto& value : values) {
+        for (const auto& value : getView()) {
             std::cout << i << ": " << value << " ";
             i++;
         }
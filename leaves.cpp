@@ -1,23 +1,13 @@
 #include "leaves.h"
+#include "transcode.h"
 #include "utils.h"
 
 namespace BSP {
-    void Leaves::load(std::ifstream& file, LumpData& lumpData) {
-        Element::load(file, lumpData);
-
-        updateYAndZ();
-    }
-
-    void Leaves::updateYAndZ() {
-        for (auto& leaf : elements) {
-            // Swap the min y and z values, then negate the new Z
-            int temp = leaf.getMin().y();
-            leaf.setMin({ leaf.getMin().x(), leaf.getMin().z(), -temp});
-
-            // Swap the max y and z values, then negate the new Z
-            temp = leaf.getMax().y();
-            leaf.setMax({ leaf.getMax().x(), leaf.getMax().z(), -temp});
-        }
+    // The max bound is followed by leafface, so the wide helper never leaves the record
+    void Leaves::transcode(const Leaf* source, Leaf* destination, size_t count) {
+        Transcode::records(source, destination, count, [](Leaf& leaf, bool) {
+            Transcode::boxWide(&leaf.min[0], &leaf.max[0]);
+        });
     }
 
     void Leaves::validate() {
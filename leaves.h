@@ -36,6 +36,8 @@ namespace BSP {
         ~Leaf() = default;
 
     private:
+        friend class Leaves;
+
         int cluster;             // The visibility cluster
         int area;                // The area portal
         Vec3i min;      // The bounding box min position
@@ -48,9 +50,11 @@ namespace BSP {
 
     class Leaves : public BSP::Element<Leaf> {
     public:
-        void load(std::ifstream& file, LumpData& lumpData) override;
-        void updateYAndZ();
         void validate() override;
         void displayData() const override;
+
+    protected:
+        bool isTranscoded() const override { return true; }
+        void transcode(const Leaf* source, Leaf* destination, size_t count) override;
     };
 }
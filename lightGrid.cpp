@@ -0,0 +1,253 @@
+#include <algorithm>
+#include <cmath>
+
+#include "lightGrid.h"
+#include "simd.h"
+
+namespace BSP {
+    static const float PI = 3.14159265358979f;
+
+    // Where a position falls in the grid along one axis
+    struct GridCoordinate {
+        int base;       // First of the two cells blended
+        float frac;     // Weight of the second cell
+    };
+
+    static GridCoordinate locate(float position, float origin, float inverseSize, int bounds) {
+        float v = (position - origin) * inverseSize;
+        v = std::min(std::max(v, 0.0f), static_cast<float>(bounds - 1));
+
+        float base = std::min(static_cast<float>(static_cast<int>(v)), static_cast<float>(std::max(bounds - 2, 0)));
+        return GridCoordinate{ static_cast<int>(base), v - base };
+    }
+
+    bool LightGrid::build(const LightVolumes& volumes, const Model& world, const Vec3f& gridSize) {
+        clear();
+
+        LumpView<LightVolume> data = volumes.getData();
+        if (data.empty()) {
+            return false;
+        }
+
+        // Back to the Quake axes the grid was compiled in
+        const float worldMin[3] = { world.getMin().x(), -world.getMax().z(), world.getMin().y() };
+        const float worldMax[3] = { world.getMax().x(), -world.getMin().z(), world.getMax().y() };
+
+        int total = 1;
+        for (int i = 0; i < 3; i++) {
+            if (gridSize[i] <= 0.0f) {
+                std::cout << "Invalid light grid size." << std::endl;
+                return false;
+            }
+
+            origin[i] = gridSize[i] * std::ceil(worldMin[i] / gridSize[i]);
+            float last = gridSize[i] * std::floor(worldMax[i] / gridSize[i]);
+
+            inverseSize[i] = 1.0f / gridSize[i];
+            bounds[i] = std::max(static_cast<int>((last - origin[i]) * inverseSize[i]) + 1, 1);
+            total *= bounds[i];
+        }
+
+        if (static_cast<size_t>(total) != data.size()) {
+            std::cout << "Light grid has " << data.size() << " cells, the world bounds need " << total << std::endl;
+            clear();
+            return false;
+        }
+
+        strides[0] = bounds[0] > 1 ? 1 : 0;
+        strides[1] = bounds[1] > 1 ? bounds[0] : 0;
+        strides[2] = bounds[2] > 1 ? bounds[0] * bounds[1] : 0;
+
+        cells.resize(total);
+        for (int i = 0; i < total; i++) {
+            const LightVolume& volume = data[i];
+            Cell& cell = cells[i];
+
+            int sum = 0;
+            for (int c = 0; c < 3; c++) {
+                cell.channels[c] = volume.ambient[c] / 255.0f;
+                cell.channels[3 + c] = volume.directional[c] / 255.0f;
+                sum += volume.ambient[c] + volume.directional[c];
+            }
+
+            float latitude = volume.direction[1] * (2.0f * PI / 256.0f);
+            float longitude = volume.direction[0] * (2.0f * PI / 256.0f);
+            cell.channels[6] = std::cos(latitude) * std::sin(longitude);
+            cell.channels[7] = std::sin(latitude) * std::sin(longitude);
+            cell.channels[8] = std::cos(longitude);
+
+            cell.lit = sum > 0 ? 1.0f : 0.0f;
+        }
+
+        return true;
+    }
+
+    void LightGrid::clear() {
+        cells.clear();
+        for (int i = 0; i < 3; i++) {
+            origin[i] = 0.0f;
+            inverseSize[i] = 0.0f;
+            bounds[i] = 0;
+            strides[i] = 0;
+        }
+    }
+
+    LightSample LightGrid::sample(const Vec3f& position) const {
+        LightSample result;
+        if (cells.empty()) {
+            return result;
+        }
+
+        const float quake[3] = { position.x(), -position.z(), position.y() };
+
+        GridCoordinate coordinates[3];
+        for (int i = 0; i < 3; i++) {
+            coordinates[i] = locate(quake[i], origin[i], inverseSize[i], bounds[i]);
+        }
+
+        int base = coordinates[0].base + coordinates[1].base * bounds[0] + coordinates[2].base * bounds[0] * bounds[1];
+
+        float accumulated[9] = {};
+        float totalWeight = 0.0f;
+
+        for (int corner = 0; corner < 8; corner++) {
+            float weights[3];
+            int index = base;
+            for (int i = 0; i < 3; i++) {
+                bool second = (corner >> i) & 1;
+                weights[i] = second ? coordinates[i].frac : 1.0f - coordinates[i].frac;
+                index += second ? strides[i] : 0;
+            }
+
+            const Cell& cell = cells[index];
+            float weight = weights[0] * weights[1] * weights[2] * cell.lit;
+
+            for (int c = 0; c < 9; c++) {
+                accumulated[c] += cell.channels[c] * weight;
+            }
+            totalWeight += weight;
+        }
+
+        // Solid cells were skipped, the others share their weight
+        float scale = totalWeight > 0.0f ? 1.0f / totalWeight : 0.0f;
+        for (int c = 0; c < 9; c++) {
+            accumulated[c] *= scale;
+        }
+
+        float length = std::sqrt(accumulated[6] * accumulated[6] + accumulated[7] * accumulated[7] + accumulated[8] * accumulated[8]);
+        float inverseLength = length > 0.0f ? 1.0f / length : 0.0f;
+
+        result.ambient = Vec3f(accumulated[0], accumulated[1], accumulated[2]);
+        result.directed = Vec3f(accumulated[3], accumulated[4], accumulated[5]);
+        result.direction = Vec3f(accumulated[6] * inverseLength, accumulated[8] * inverseLength, -(accumulated[7] * inverseLength));
+        return result;
+    }
+
+    void LightGrid::sample(const Vec3f* positions, size_t count, LightSample* results) const {
+        size_t i = 0;
+
+#if BSP_SIMD_SSE2
+        if (!cells.empty()) {
+            const __m128 zero = _mm_setzero_ps();
+            const __m128 one = _mm_set1_ps(1.0f);
+
+            __m128 origins[3], inverseSizes[3], lastCells[3], maxBases[3];
+            for (int axis = 0; axis < 3; axis++) {
+                origins[axis] = _mm_set1_ps(origin[axis]);
+                inverseSizes[axis] = _mm_set1_ps(inverseSize[axis]);
+                lastCells[axis] = _mm_set1_ps(static_cast<float>(bounds[axis] - 1));
+                maxBases[axis] = _mm_set1_ps(static_cast<float>(std::max(bounds[axis] - 2, 0)));
+            }
+
+            for (; i + 4 <= count; i += 4) {
+                const Vec3f* p = positions + i;
+
+                // Same axes as sample(): Quake x, y, z are x, -z, y
+                __m128 quake[3] = {
+                    _mm_setr_ps(p[0].x(), p[1].x(), p[2].x(), p[3].x()),
+                    _mm_setr_ps(-p[0].z(), -p[1].z(), -p[2].z(), -p[3].z()),
+                    _mm_setr_ps(p[0].y(), p[1].y(), p[2].y(), p[3].y())
+                };
+
+                __m128 fracs[3];
+                alignas(16) int bases[3][4];
+                for (int axis = 0; axis < 3; axis++) {
+                    __m128 v = _mm_mul_ps(_mm_sub_ps(quake[axis], origins[axis]), inverseSizes[axis]);
+                    v = _mm_min_ps(_mm_max_ps(v, zero), lastCells[axis]);
+
+                    // v is never negative here, so truncating is flooring
+                    __m128 base = _mm_min_ps(_mm_cvtepi32_ps(_mm_cvttps_epi32(v)), maxBases[axis]);
+                    fracs[axis] = _mm_sub_ps(v, base);
+                    _mm_store_si128(reinterpret_cast<__m128i*>(bases[axis]), _mm_cvttps_epi32(base));
+                }
+
+                int baseIndices[4];
+                for (int lane = 0; lane < 4; lane++) {
+                    baseIndices[lane] = bases[0][lane] + bases[1][lane] * bounds[0] + bases[2][lane] * bounds[0] * bounds[1];
+                }
+
+                __m128 accumulated[9];
+                for (int c = 0; c < 9; c++) {
+                    accumulated[c] = zero;
+                }
+                __m128 totalWeight = zero;
+
+                for (int corner = 0; corner < 8; corner++) {
+                    __m128 weights[3];
+                    int offset = 0;
+                    for (int axis = 0; axis < 3; axis++) {
+                        bool second = (corner >> axis) & 1;
+                        weights[axis] = second ? fracs[axis] : _mm_sub_ps(one, fracs[axis]);
+                        offset += second ? strides[axis] : 0;
+                    }
+
+                    const Cell* corners[4] = {
+                        &cells[baseIndices[0] + offset], &cells[baseIndices[1] + offset],
+                        &cells[baseIndices[2] + offset], &cells[baseIndices[3] + offset]
+                    };
+
+                    __m128 lit = _mm_setr_ps(corners[0]->lit, corners[1]->lit, corners[2]->lit, corners[3]->lit);
+                    __m128 weight = _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(weights[0], weights[1]), weights[2]), lit);
+
+                    for (int c = 0; c < 9; c++) {
+                        __m128 channel = _mm_setr_ps(corners[0]->channels[c], corners[1]->channels[c], corners[2]->channels[c], corners[3]->channels[c]);
+                        accumulated[c] = _mm_add_ps(accumulated[c], _mm_mul_ps(channel, weight));
+                    }
+                    totalWeight = _mm_add_ps(totalWeight, weight);
+                }
+
+                // Lanes without any lit cell get a scale of 0 instead of the division by zero
+                __m128 scale = _mm_and_ps(_mm_cmpgt_ps(totalWeight, zero), _mm_div_ps(one, totalWeight));
+                for (int c = 0; c < 9; c++) {
+                    accumulated[c] = _mm_mul_ps(accumulated[c], scale);
+                }
+
+                __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(
+                    _mm_mul_ps(accumulated[6], accumulated[6]),
+                    _mm_mul_ps(accumulated[7], accumulated[7])),
+                    _mm_mul_ps(accumulated[8], accumulated[8])));
+                __m128 inverseLength = _mm_and_ps(_mm_cmpgt_ps(length, zero), _mm_div_ps(one, length));
+                for (int c = 6; c < 9; c++) {
+                    accumulated[c] = _mm_mul_ps(accumulated[c], inverseLength);
+                }
+
+                alignas(16) float lanes[9][4];
+                for (int c = 0; c < 9; c++) {
+                    _mm_store_ps(lanes[c], accumulated[c]);
+                }
+
+                for (int lane = 0; lane < 4; lane++) {
+                    LightSample& result = results[i + lane];
+                    result.ambient = Vec3f(lanes[0][lane], lanes[1][lane], lanes[2][lane]);
+                    result.directed = Vec3f(lanes[3][lane], lanes[4][lane], lanes[5][lane]);
+                    result.direction = Vec3f(lanes[6][lane], lanes[8][lane], -lanes[7][lane]);
+                }
+            }
+        }
+#endif
+
+        for (; i < count; i++) {
+            results[i] = sample(positions[i]);
+        }
+    }
+}
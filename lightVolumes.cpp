@@ -0,0 +1,21 @@
+#include "lightVolumes.h"
+#include "utils.h"
+
+namespace BSP {
+    void LightVolumes::validate() {
+        // Every byte is a valid color or angle, an empty grid only means the map has no light grid
+        warning_assert(!getData().empty(), "Light volume lump is empty.");
+    }
+
+    void LightVolumes::displayData() const {
+        std::cout << "Displaying Light Volume Data:" << std::endl;
+        int count = 0;
+        for (const auto& volume : getData()) {
+            std::cout << "Light Volume " << count << ": " << std::endl;
+            std::cout << "  Ambient: (" << static_cast<int>(volume.ambient[0]) << ", " << static_cast<int>(volume.ambient[1]) << ", " << static_cast<int>(volume.ambient[2]) << ")" << std::endl;
+            std::cout << "  Directional: (" << static_cast<int>(volume.directional[0]) << ", " << static_cast<int>(volume.directional[1]) << ", " << static_cast<int>(volume.directional[2]) << ")" << std::endl;
+            std::cout << "  Direction: (" << static_cast<int>(volume.direction[0]) << ", " << static_cast<int>(volume.direction[1]) << ")" << std::endl;
+            count++;
+        }
+    }
+}
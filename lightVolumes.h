@@ -0,0 +1,27 @@
+#pragma once
+
+#include "BSPElement.h"
+
+/*
+The light volumes lump is the light grid of the map: a regular 3D grid over the world model bounds
+(64x64x128 units per cell unless worldspawn sets "gridsize") that stores the light reaching each
+point of space, so models moving around the map can be lit without tracing anything.
+
+Each cell has an ambient color, a directed color and the direction the directed light comes from,
+as two spherical angles. Cells inside solid space are all black.
+*/
+
+namespace BSP {
+    class LightVolume {
+    public:
+        unsigned char ambient[3];       // Ambient color (RGB)
+        unsigned char directional[3];   // Directional color (RGB)
+        unsigned char direction[2];     // Direction to the light: phi and theta, 256 steps per turn
+    };
+
+    class LightVolumes : public BSP::Element<LightVolume> {
+    public:
+        void validate() override;
+        void displayData() const override;
+    };
+}
@@ -1,20 +1,163 @@
 #include "lightmaps.h"
+#include "glStateCache.h"
+#include "simd.h"
 #include "utils.h"
 
 namespace BSP {
+	Lightmaps::~Lightmaps() {
+		deleteTextures();
+	}
+
+	void Lightmaps::deleteTextures() {
+		// Textures only exist when upload() ran, so headless loads never touch GL here
+		if (textures.empty())
+			return;
+
+		glDeleteTextures(static_cast<GLsizei>(textures.size()), textures.data());
+		textures.clear();
+	}
+
+	// Scalar reference of convertToRGBA, also used for the texels the SIMD loop leaves over
+	static void convertTexel(const unsigned char* rgb, unsigned char* rgba, int overbrightShift) {
+		int r = rgb[0] << overbrightShift;
+		int g = rgb[1] << overbrightShift;
+		int b = rgb[2] << overbrightShift;
+
+		int brightest = std::max(r, std::max(g, b));
+		if (brightest > 255) {
+			float scale = 255.0f / static_cast<float>(brightest);
+			r = static_cast<int>(static_cast<float>(r) * scale);
+			g = static_cast<int>(static_cast<float>(g) * scale);
+			b = static_cast<int>(static_cast<float>(b) * scale);
+		}
+
+		rgba[0] = static_cast<unsigned char>(r);
+		rgba[1] = static_cast<unsigned char>(g);
+		rgba[2] = static_cast<unsigned char>(b);
+		rgba[3] = 255;
+	}
+
+#if BSP_SIMD_SSE2
+	// Scale two texels (RGBA as 32-bit lanes) by 255 / max(brightest channel, 255)
+	static __m128i normalizeTexel(__m128i color, __m128i brightest) {
+		const __m128 full = _mm_set1_ps(255.0f);
+
+		__m128 scale = _mm_div_ps(full, _mm_max_ps(_mm_cvtepi32_ps(brightest), full));
+		return _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(color), scale));
+	}
+
+	// Four texels per iteration: the channels are widened to 16 bits, shifted, and every
+	// lane gets the brightest channel of its texel through in-register shuffles
+	static size_t convertTexelsSSE2(const unsigned char* rgb, unsigned char* rgba, size_t texelCount, int overbrightShift) {
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xFF000000u));
+		const __m128i shift = _mm_cvtsi32_si128(overbrightShift);
+
+		size_t texel = 0;
+		for (; texel + 4 <= texelCount; texel += 4) {
+			const unsigned char* source = rgb + texel * 3;
+			alignas(16) unsigned char expanded[16] = {
+				source[0], source[1], source[2], 0,
+				source[3], source[4], source[5], 0,
+				source[6], source[7], source[8], 0,
+				source[9], source[10], source[11], 0
+			};
+			__m128i pixels = _mm_load_si128(reinterpret_cast<const __m128i*>(expanded));
+
+			__m128i texels[2] = {
+				_mm_sll_epi16(_mm_unpacklo_epi8(pixels, zero), shift),
+				_mm_sll_epi16(_mm_unpackhi_epi8(pixels, zero), shift)
+			};
+
+			__m128i result[4];
+			for (int half = 0; half < 2; half++) {
+				__m128i c = texels[half];
+
+				// (g, b, r, a) and (b, r, g, a) of each texel, alpha is 0 so it never wins
+				__m128i rotated1 = _mm_shufflehi_epi16(_mm_shufflelo_epi16(c, _MM_SHUFFLE(3, 0, 2, 1)), _MM_SHUFFLE(3, 0, 2, 1));
+				__m128i rotated2 = _mm_shufflehi_epi16(_mm_shufflelo_epi16(c, _MM_SHUFFLE(3, 1, 0, 2)), _MM_SHUFFLE(3, 1, 0, 2));
+				__m128i brightest = _mm_max_epi16(c, _mm_max_epi16(rotated1, rotated2));
+
+				result[half * 2] = normalizeTexel(_mm_unpacklo_epi16(c, zero), _mm_unpacklo_epi16(brightest, zero));
+				result[half * 2 + 1] = normalizeTexel(_mm_unpackhi_epi16(c, zero), _mm_unpackhi_epi16(brightest, zero));
+			}
+
+			__m128i packed = _mm_packus_epi16(_mm_packs_epi32(result[0], result[1]), _mm_packs_epi32(result[2], result[3]));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(rgba + texel * 4), _mm_or_si128(packed, alpha));
+		}
+
+		return texel;
+	}
+#endif
+
+	void Lightmaps::convertToRGBA(const unsigned char* rgb, unsigned char* rgba, size_t texelCount, int overbrightShift) {
+		size_t texel = 0;
+
+#if BSP_SIMD_SSE2
+		texel = convertTexelsSSE2(rgb, rgba, texelCount, overbrightShift);
+#endif
+
+		for (; texel < texelCount; texel++)
+			convertTexel(rgb + texel * 3, rgba + texel * 4, overbrightShift);
+	}
+
+	void Lightmaps::upload(int overbrightShift) {
+		// A map without lightmaps must not keep the ones of the map loaded before
+		deleteTextures();
+
+		LumpView<Lightmap> lightmaps = getData();
+		if (lightmaps.empty())
+			return;
+
+		const size_t texelCount = Lightmap::SIZE * Lightmap::SIZE;
+
+		// One scratch image is reused for every lightmap, the RGBA copy never exists for the whole lump
+		std::vector<unsigned char> rgba(texelCount * 4);
+
+		textures.resize(lightmaps.size());
+		glGenTextures(static_cast<GLsizei>(textures.size()), textures.data());
+
+		// Bound through the cache, so it never believes an old binding of unit 0 is still there
+		GLStateCache& state = GLStateCache::shared();
+
+		for (size_t i = 0; i < lightmaps.size(); i++) {
+			convertToRGBA(&lightmaps[i].imageBits[0][0][0], rgba.data(), texelCount, overbrightShift);
+
+			state.bindTexture(0, GL_TEXTURE_2D, textures[i]);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, Lightmap::SIZE, Lightmap::SIZE, 0, GL_RGBA, GL_UNSIGNED_BYTE, rgba.data());
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		}
+
+		state.bindTexture(0, GL_TEXTURE_2D, 0);
+		checkGLError("Lightmaps upload");
+
+		release();
+	}
+
+	GLuint Lightmaps::getTexture(int index) const {
+		if (index < 0 || index >= static_cast<int>(textures.size()))
+			return 0;
+
+		return textures[index];
+	}
+
+	void Lightmaps::release() {
+		// swap() actually frees the storage, clear() would keep the capacity
+		std::vector<Lightmap>().swap(elements);
+		mapped = LumpView<Lightmap>();
+	}
+
 	void Lightmaps::displayData() const {
-		for (const auto& lightmap : elements) {
+		for (const auto& lightmap : getData()) {
 			for (const auto& row : lightmap.imageBits) {
 				for (const auto& pixel : row) {
-					// Access each color channel of the pixel
-					char red = pixel[0];
-					char green = pixel[1];
-					char blue = pixel[2];
-
 					// Print each color channel value, separated by commas
-					std::cout << "(" << static_cast<int>(red) << ", "
-						<< static_cast<int>(green) << ", "
-						<< static_cast<int>(blue) << ") ";
+					std::cout << "(" << static_cast<int>(pixel[0]) << ", "
+						<< static_cast<int>(pixel[1]) << ", "
+						<< static_cast<int>(pixel[2]) << ") ";
 				}
 				// Print a newline at the end of each row
 				std::cout << std::endl;
@@ -25,17 +168,7 @@ namespace BSP {
 	}
 
 	void Lightmaps::validate() {
-		for (const auto& lightmap : elements) {
-			for (int i = 0; i < 128; i++) {
-				for (int j = 0; j < 128; j++) {
-					const auto& pixel = lightmap.imageBits[i][j];
-					// Check if each color channel value is between 0 and 255
-					for (int k = 0; k < 3; k++) {
-						warning_assert(pixel[k] >= 0 && pixel[k] <= 255, "Invalid RGB value.");
-						std::cout << pixel[k] << std::endl;
-					}
-				}
-			}
-		}
+		// Every byte is a valid channel value, so only the lump size can be wrong (MAX_MAP_LIGHTING in q3map)
+		warning_assert(size() * sizeof(Lightmap) <= 0x800000, "Lightmap lump is larger than Quake III allows.");
 	}
-}
\ No newline at end of file
+}
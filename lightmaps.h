@@ -1,20 +1,50 @@
 #pragma once
 
+#include <vector>
+
 #include "BSPElement.h"
+#include "GL_Utils.h"
 
 namespace BSP {
     class Lightmap {
     public:
-        Lightmap() {};
-        ~Lightmap() {};
+        static const int SIZE = 128;
 
-        // The RGB data in a 128x128 image
-        Vec3ui imageBits[128][128];
+        // The RGB data in a 128x128 image, same layout as on disk (3 bytes per texel)
+        unsigned char imageBits[SIZE][SIZE][3];
     };
 
     class Lightmaps : public BSP::Element<Lightmap> {
     public:
+        Lightmaps() = default;
+        ~Lightmaps();
+
+        Lightmaps(const Lightmaps&) = delete;
+        Lightmaps& operator=(const Lightmaps&) = delete;
+
+        // Create one RGBA8 texture per lightmap, then release the CPU copy. The textures of a previous
+        // upload are deleted first. overbrightShift brightens the texels by 2^shift like Quake III does
+        // (1 when there is no hardware gamma).
+        void upload(int overbrightShift = 1);
+
+        // Delete the textures of the last upload(), for a reload or before the GL context goes away
+        void deleteTextures();
+
+        // Texture of a lightmap after upload(), 0 for faces without a lightmap (negative index)
+        GLuint getTexture(int index) const;
+        size_t getTextureCount() const { return textures.size(); }
+
+        // Drop the texels, the loaded lump is no longer needed once it lives on the GPU
+        void release();
+
+        // Convert RGB8 texels into RGBA8 with overbright applied. Channels that saturate are
+        // scaled down together so the hue is kept instead of clamping each channel to white.
+        static void convertToRGBA(const unsigned char* rgb, unsigned char* rgba, size_t texelCount, int overbrightShift);
+
         void validate() override;
         void displayData() const override;
+
+    private:
+        std::vector<GLuint> textures;
     };
-}
\ No newline at end of file
+}
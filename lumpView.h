@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+
+// Read-only typed window over contiguous elements that live somewhere else
+// (a std::vector owned by a BSP element or a memory-mapped .bsp file).
+// The view never owns its data, so it must not outlive the storage it points to.
+template <typename T>
+class LumpView {
+public:
+    LumpView() : first(nullptr), count(0) {}
+    LumpView(const T* first, size_t count) : first(first), count(count) {}
+
+    const T* data() const { return first; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    const T* begin() const { return first; }
+    const T* end() const { return first + count; }
+
+    const T& operator[](size_t index) const { return first[index]; }
+
+private:
+    const T* first;
+    size_t count;
+};
@@ -9,12 +9,18 @@
 #include "BasicShapes.h"
 #include "shaders.h"
 #include "bsp.h"
+#include "glStateCache.h"
+#include "cameraUniforms.h"
+#include "renderQueueCheck.h"
 
 using namespace std;
 
 int WINDOW_WIDTH = 1280;
 int WINDOW_HEIGHT = 720;
 
+// How much map geometry is handed to the GL per frame while loading
+const size_t UPLOAD_BUDGET_PER_FRAME = 4 * 1024 * 1024;
+
 // Function to set up the camera
 PerspectiveCamera setupCamera() {
     PerspectiveCamera camera(60, WINDOW_WIDTH / WINDOW_HEIGHT, 0.1f, 10000.0f);
@@ -28,27 +34,116 @@ PerspectiveCamera setupCamera() {
 }
 
 // Function to render a frame
-void renderFrame(PerspectiveCamera& camera, GLuint shaderProgram, BSP::Loader& map) {
+void renderFrame(PerspectiveCamera& camera, CameraUniforms& cameraUniforms, DebugDraw& debugDraw, GLuint shaderProgram,
+    BSP::Loader& map, bool drawLeafBounds) {
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); // Clear the screen
 
     camera.updateViewMatrix();
     camera.updateProjectionMatrix();
 
-    Mat4<float> modelMatrix = Mat4<float>{}; // Use identity matrix or set your desired model matrix here
-    Mat4<float> viewMatrix = camera.getViewMatrix().transpose();
-    Mat4<float> projectionMatrix = camera.getProjectionMatrix().transpose();
+    // Every program reads the camera from the uniform buffer, it is only uploaded when the camera moved
+    cameraUniforms.update(camera);
+
+    // Binds go through the cache, calls that change nothing never reach the driver
+    GLStateCache::shared().useProgram(shaderProgram); // Use the shader program
+
+    // Submodels (doors, platforms...) are culled against the camera
+    map.setViewMatrices(camera.getViewMatrix(), camera.getProjectionMatrix());
+    map.drawLevel(camera.getPosition(), shaderProgram);
+
+    drawAxes(debugDraw); // Draw coordinate axes
+
+    if (drawLeafBounds) {
+        for (const BSP::Leaf& leaf : map.getLeaves().getData()) {
+            Vec3f min(leaf.getMin()[0], leaf.getMin()[1], leaf.getMin()[2]);
+            Vec3f max(leaf.getMax()[0], leaf.getMax()[1], leaf.getMax()[2]);
+            debugDraw.box(min, max, Vec3f(1.0f, 1.0f, 0.0f));
+        }
+    }
+
+    // Every debug shape of the frame, depth tested against the level
+    debugDraw.flush();
+}
 
-    glUseProgram(shaderProgram); // Use the shader program
-    glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "model"), 1, GL_FALSE, modelMatrix.getData());
-    glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "view"), 1, GL_FALSE, viewMatrix.getData());
-    glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "projection"), 1, GL_FALSE, projectionMatrix.getData());
+// Print the occlusion culling counters of the last frame, once per second while it is on
+void printOcclusionStats(const BSP::Loader& map) {
+    static double previousTime = glfwGetTime();
 
-    drawAxes(shaderProgram); // Draw coordinate axes
+    double currentTime = glfwGetTime();
+    if ((!map.isOcclusionCulling() && !map.isSoftwareOcclusion()) || currentTime - previousTime < 1.0) {
+        return;
+    }
 
-    map.drawLevel(Vec3<float>(0.0f, 0.0f, 0.0f), shaderProgram);
+    if (map.isOcclusionCulling()) {
+        std::cout << "Occlusion culling: " << map.getOccludedLeafCount() << " leaves culled, "
+            << map.getOcclusionQueryCount() << " queries" << std::endl;
+    }
+    if (map.isSoftwareOcclusion()) {
+        std::cout << "Software occlusion: " << map.getSoftwareCulledLeafCount() << " leaves and "
+            << map.getSoftwareCulledPatchCount() << " patches culled, "
+            << map.getOcclusionRasterizer().getRasterizedTriangleCount() << " occluder triangles drawn" << std::endl;
+    }
+    previousTime = currentTime;
+}
+
+// Print the GL state calls made and skipped by the state cache, per frame over the last second
+void printStateCacheStats() {
+    static double previousTime = glfwGetTime();
+    static int frameCount = 0;
+
+    frameCount++;
+    double currentTime = glfwGetTime();
+    if (currentTime - previousTime < 1.0) {
+        return;
+    }
+
+    GLStateCache& state = GLStateCache::shared();
+    const GLStateCache::Counters& counters = state.getCounters();
+    std::cout << "State cache per frame: " << counters.issued / frameCount << " calls issued, "
+        << counters.elided / frameCount << " elided, " << counters.uniformLookups / frameCount << " uniform lookups, "
+        << counters.uniformHits / frameCount << " served from the cache" << std::endl;
+
+    state.resetCounters();
+    frameCount = 0;
+    previousTime = currentTime;
+}
+
+// Function to render the loading screen: a progress bar cleared with the scissor box
+void renderLoadingScreen(GLFWwindow* window, float progress) {
+    int width, height;
+    glfwGetFramebufferSize(window, &width, &height);
+
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    int barWidth = width * 3 / 4;
+    int barHeight = height / 40 + 1;
+    int barX = (width - barWidth) / 2;
+    int barY = height / 8;
+
+    glEnable(GL_SCISSOR_TEST);
+
+    glScissor(barX, barY, barWidth, barHeight);
+    glClearColor(0.2f, 0.2f, 0.2f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    glScissor(barX, barY, static_cast<int>(barWidth * progress), barHeight);
+    glClearColor(0.9f, 0.6f, 0.1f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    glDisable(GL_SCISSOR_TEST);
+    glClearColor(0.5f, 0.5f, 0.5f, 1.0f); // Restore the background color
+
+    progressBar(progress);
 }
 
 int main(int argc, char* argv[]) {
+    // The render queue is checked and timed on its own, without a window or a map
+    if (argc > 1 && string(argv[1]) == "--check-render-queue") {
+        bool passed = BSP::checkRenderQueue();
+        BSP::benchmarkRenderQueue(100000, 100);
+        return passed ? 0 : 1;
+    }
+
     if (!initGLFW()) {
         return -1; // GLFW initialization failed
     }
@@ -76,11 +171,20 @@ int main(int argc, char* argv[]) {
     setupOpenGL();
     GLuint shaderProgram = initShader(); // Initialize shader
 
+    CameraUniforms cameraUniforms; // View and projection shared by every program
+    cameraUniforms.create();
+
+    DebugDraw debugDraw; // Axes, bounds and other debug shapes, drawn at the end of the frame
+    debugDraw.create();
+
     PerspectiveCamera camera = setupCamera(); // Setup camera
     CameraController cameraController(camera, WINDOW_WIDTH, WINDOW_HEIGHT); // Create camera controller
 
-    BSP::Loader BSPMap; // Load BSP map
-    if (!BSPMap.load("maps/render.bsp")) {
+    BSP::Loader BSPMap; // Load BSP map in the background, frames keep being presented meanwhile
+    BSPMap.setLoadMode(BSP::LoadMode::MemoryMapped);
+    BSPMap.setPatchLod(true); // Curved surfaces lose detail with distance, one pixel of error at most
+    BSPMap.setPatchLodError(1.0f, WINDOW_HEIGHT);
+    if (!BSPMap.loadAsync("maps/render.bsp")) {
         std::cerr << "Error loading BSP file" << std::endl;
         return -1;
     }
@@ -118,6 +222,56 @@ int main(int argc, char* argv[]) {
         }
         });
 
+    // F4 shows the bounds of every BSP leaf
+    bool drawLeafBounds = false;
+    eventSystem.addListener(EventType::KeyPress, [&drawLeafBounds](const Event& event) {
+        const KeyEvent& keyEvent = static_cast<const KeyEvent&>(event);
+        if (keyEvent.action == GLFW_PRESS && keyEvent.key == GLFW_KEY_F4) {
+            drawLeafBounds = !drawLeafBounds;
+        }
+        });
+
+    // F5 switches between texture order and front to back with a depth pre-pass. The fragments shaded
+    // in the mode being left are printed, to compare both on the same view.
+    BSPMap.setMeasureFragments(true);
+    eventSystem.addListener(EventType::KeyPress, [&BSPMap](const Event& event) {
+        const KeyEvent& keyEvent = static_cast<const KeyEvent&>(event);
+        if (keyEvent.action == GLFW_PRESS && keyEvent.key == GLFW_KEY_F5) {
+            bool frontToBack = !BSPMap.isFrontToBack();
+            std::cout << "Fragments shaded " << (frontToBack ? "in texture order: " : "front to back with depth pre-pass: ")
+                << BSPMap.getFragmentCount() << std::endl;
+
+            BSPMap.setFrontToBack(frontToBack);
+            BSPMap.setDepthPrepass(frontToBack);
+        }
+        });
+
+    // F6 toggles occlusion culling of the BSP leaves
+    eventSystem.addListener(EventType::KeyPress, [&BSPMap](const Event& event) {
+        const KeyEvent& keyEvent = static_cast<const KeyEvent&>(event);
+        if (keyEvent.action == GLFW_PRESS && keyEvent.key == GLFW_KEY_F6) {
+            BSPMap.setOcclusionCulling(!BSPMap.isOcclusionCulling());
+        }
+        });
+
+    // F7 toggles the occlusion culling against occluders rasterized on the CPU
+    eventSystem.addListener(EventType::KeyPress, [&BSPMap](const Event& event) {
+        const KeyEvent& keyEvent = static_cast<const KeyEvent&>(event);
+        if (keyEvent.action == GLFW_PRESS && keyEvent.key == GLFW_KEY_F7) {
+            BSPMap.setSoftwareOcclusion(!BSPMap.isSoftwareOcclusion());
+        }
+        });
+
+    // F8 switches the patches between the level of detail and the full tessellation
+    eventSystem.addListener(EventType::KeyPress, [&BSPMap](const Event& event) {
+        const KeyEvent& keyEvent = static_cast<const KeyEvent&>(event);
+        if (keyEvent.action == GLFW_PRESS && keyEvent.key == GLFW_KEY_F8) {
+            std::cout << "Patch triangles " << (BSPMap.isPatchLod() ? "with level of detail: " : "at the full level: ")
+                << BSPMap.getPatchTriangleCount() << std::endl;
+            BSPMap.setPatchLod(!BSPMap.isPatchLod());
+        }
+        });
+
     // Listener for F1, F2, F3 keys to toggle rendering modes
     eventSystem.addListener(EventType::KeyPress, [&BSPMap](const Event& event) {
         const KeyEvent& keyEvent = static_cast<const KeyEvent&>(event);
@@ -142,7 +296,24 @@ int main(int argc, char* argv[]) {
         });
 
     while (!glfwWindowShouldClose(window)) {
-        renderFrame(camera, shaderProgram, BSPMap); // Render the frame
+        if (BSPMap.isLoaded()) {
+            renderFrame(camera, cameraUniforms, debugDraw, shaderProgram, BSPMap, drawLeafBounds); // Render the frame
+            printOcclusionStats(BSPMap);
+            printStateCacheStats();
+        }
+        else {
+            // Upload a slice of the map, the frame stays responsive while it loads
+            if (BSPMap.updateAsyncLoad(UPLOAD_BUDGET_PER_FRAME)) {
+                std::cout << std::endl << "Map loaded" << std::endl;
+                GLStateCache::shared().resetCounters(); // The stats only count the frames of the map
+            }
+            else if (BSPMap.getLoadState() == BSP::LoadState::Failed) {
+                std::cerr << std::endl << "Error loading BSP file" << std::endl;
+                break;
+            }
+
+            renderLoadingScreen(window, BSPMap.getLoadProgress());
+        }
 
         printFPS(window); // Calculate and print the FPS in the window title
 
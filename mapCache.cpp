@@ -0,0 +1,142 @@
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "mapCache.h"
+
+namespace BSP {
+    // Bump whenever the layout of the cooked data changes
+    static const int COOKED_VERSION = 3;
+
+    // 64-bit FNV-1a
+    static uint64_t hashBytes(const void* data, size_t size, uint64_t hash = 14695981039346656037ULL) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; i++) {
+            hash ^= bytes[i];
+            hash *= 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    std::string MapCache::pathFor(const std::string& bspFilename) {
+        return bspFilename + ".cooked";
+    }
+
+    bool MapCache::computeKey(const std::string& bspFilename, int tesselationLevel, int vertexFormat,
+        int indexOrder, uint64_t& key) {
+        MappedFile bsp;
+        if (!bsp.open(bspFilename)) {
+            return false;
+        }
+
+        int parameters[] = { COOKED_VERSION, vertexFormat, tesselationLevel, indexOrder };
+
+        key = hashBytes(bsp.data(), bsp.size());
+        key = hashBytes(parameters, sizeof(parameters), key);
+
+        return true;
+    }
+
+    bool MapCache::open(const std::string& path, uint64_t key) {
+        close();
+
+        std::ifstream probe(path, std::ios::binary);
+        if (!probe.is_open()) {
+            // No cache yet, not an error
+            return false;
+        }
+        probe.close();
+
+        if (!file.open(path) || file.size() < sizeof(Header)) {
+            close();
+            return false;
+        }
+
+        Header header;
+        std::memcpy(&header, file.data(), sizeof(Header));
+
+        if (strncmp(header.strID, "QCKD", 4) != 0 || header.version != COOKED_VERSION || header.key != key) {
+            std::cout << "Cooked map cache '" << path << "' is stale, rebuilding it" << std::endl;
+            close();
+            return false;
+        }
+
+        size_t expectedSize = sizeof(Header)
+            + header.faceVertexBytes
+            + header.faceIndices * sizeof(GLuint)
+            + header.patchVertexBytes
+            + header.patchIndices * sizeof(GLuint)
+            + header.faceRanges * sizeof(DrawRange);
+
+        if (header.faceVertexBytes < 0 || header.faceIndices < 0 || header.patchVertexBytes < 0 ||
+            header.patchIndices < 0 || header.faceRanges < 0 || file.size() != expectedSize) {
+            std::cout << "Cooked map cache '" << path << "' is corrupt, rebuilding it" << std::endl;
+            close();
+            return false;
+        }
+
+        const char* cursor = file.data() + sizeof(Header);
+
+        faceVertexData = LumpView<unsigned char>(reinterpret_cast<const unsigned char*>(cursor), header.faceVertexBytes);
+        cursor += header.faceVertexBytes;
+
+        faceIndexData = LumpView<GLuint>(reinterpret_cast<const GLuint*>(cursor), header.faceIndices);
+        cursor += header.faceIndices * sizeof(GLuint);
+
+        patchVertexData = LumpView<unsigned char>(reinterpret_cast<const unsigned char*>(cursor), header.patchVertexBytes);
+        cursor += header.patchVertexBytes;
+
+        patchIndexData = LumpView<GLuint>(reinterpret_cast<const GLuint*>(cursor), header.patchIndices);
+        cursor += header.patchIndices * sizeof(GLuint);
+
+        faceRanges = LumpView<DrawRange>(reinterpret_cast<const DrawRange*>(cursor), header.faceRanges);
+
+        return true;
+    }
+
+    void MapCache::close() {
+        faceVertexData = LumpView<unsigned char>();
+        faceIndexData = LumpView<GLuint>();
+        patchVertexData = LumpView<unsigned char>();
+        patchIndexData = LumpView<GLuint>();
+        faceRanges = LumpView<DrawRange>();
+
+        file.close();
+    }
+
+    bool MapCache::write(const std::string& path, uint64_t key, const CookedGeometry& geometry) {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) {
+            std::cout << "Could not write cooked map cache: " << path << std::endl;
+            return false;
+        }
+
+        Header header = {};
+        std::memcpy(header.strID, "QCKD", 4);
+        header.version = COOKED_VERSION;
+        header.key = key;
+        header.faceVertexBytes = static_cast<int>(geometry.faceVertexData.size());
+        header.faceIndices = static_cast<int>(geometry.faceIndexData.size());
+        header.patchVertexBytes = static_cast<int>(geometry.patchVertexData.size());
+        header.patchIndices = static_cast<int>(geometry.patchIndexData.size());
+        header.faceRanges = static_cast<int>(geometry.faceRanges.size());
+
+        out.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+        out.write(reinterpret_cast<const char*>(geometry.faceVertexData.data()), geometry.faceVertexData.size());
+        out.write(reinterpret_cast<const char*>(geometry.faceIndexData.data()), geometry.faceIndexData.size() * sizeof(GLuint));
+        out.write(reinterpret_cast<const char*>(geometry.patchVertexData.data()), geometry.patchVertexData.size());
+        out.write(reinterpret_cast<const char*>(geometry.patchIndexData.data()), geometry.patchIndexData.size() * sizeof(GLuint));
+        out.write(reinterpret_cast<const char*>(geometry.faceRanges.data()), geometry.faceRanges.size() * sizeof(DrawRange));
+
+        if (!out.good()) {
+            // Never leave a half written cache behind
+            out.close();
+            std::remove(path.c_str());
+            std::cout << "Could not write cooked map cache: " << path << std::endl;
+            return false;
+        }
+
+        return true;
+    }
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "GL_Utils.h"
+#include "drawRange.h"
+#include "lumpView.h"
+#include "mappedFile.h"
+
+namespace BSP {
+    // Everything the loader uploads, in the exact layout glBufferData receives it
+    struct CookedGeometry {
+        std::vector<unsigned char> faceVertexData;  // Vertices of polygons and meshes in the VertexFormat, each one stored once
+        std::vector<GLuint> faceIndexData;      // Triangle indices of polygons and meshes, relative to baseVertex
+        std::vector<unsigned char> patchVertexData; // Vertices of the tessellated patches in the VertexFormat
+        std::vector<GLuint> patchIndexData;     // Triangle indices into patchVertexData
+        std::vector<DrawRange> faceRanges;      // One entry per face of the map
+    };
+
+    /*
+    Cooked map cache, stored next to the .bsp as "<map>.bsp.cooked".
+
+    Building the vertex streams and tessellating every patch gives the same result on every run, so
+    the result is written once and memory-mapped on the next start. The key hashes the .bsp bytes
+    together with everything that changes the output (tessellation level, vertex format and the cache
+    layout), so a stale cache is simply rebuilt.
+    */
+    class MapCache {
+    public:
+        static std::string pathFor(const std::string& bspFilename);
+
+        // vertexFormat is VertexFormat::id() of the layout the vertices are cooked in, indexOrder
+        // the flags of the index optimizations that were applied
+        static bool computeKey(const std::string& bspFilename, int tesselationLevel, int vertexFormat,
+            int indexOrder, uint64_t& key);
+
+        // Map the cache file, fails if it is missing, truncated or was cooked with a different key
+        bool open(const std::string& path, uint64_t key);
+        void close();
+
+        static bool write(const std::string& path, uint64_t key, const CookedGeometry& geometry);
+
+        // Views into the mapping, valid until close()
+        LumpView<unsigned char> getFaceVertexData() const { return faceVertexData; }
+        LumpView<GLuint> getFaceIndexData() const { return faceIndexData; }
+        LumpView<unsigned char> getPatchVertexData() const { return patchVertexData; }
+        LumpView<GLuint> getPatchIndexData() const { return patchIndexData; }
+        LumpView<DrawRange> getFaceRanges() const { return faceRanges; }
+
+    private:
+        struct Header {
+            char strID[4];              // Always 'QCKD'
+            int version;                // COOKED_VERSION
+            uint64_t key;               // computeKey() of the source map
+            int faceVertexBytes;
+            int faceIndices;
+            int patchVertexBytes;
+            int patchIndices;
+            int faceRanges;
+        };
+
+        MappedFile file;
+        LumpView<unsigned char> faceVertexData;
+        LumpView<GLuint> faceIndexData;
+        LumpView<unsigned char> patchVertexData;
+        LumpView<GLuint> patchIndexData;
+        LumpView<DrawRange> faceRanges;
+    };
+}
@@ -0,0 +1,128 @@
+#include <iostream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "mappedFile.h"
+
+namespace BSP {
+    MappedFile::~MappedFile() {
+        close();
+    }
+
+#ifdef _WIN32
+    bool MappedFile::open(const std::string& filename) {
+        close();
+
+        HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (file == INVALID_HANDLE_VALUE) {
+            std::cout << "Could not open file for mapping: " << filename << std::endl;
+            return false;
+        }
+
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+            std::cout << "Could not map empty file: " << filename << std::endl;
+            CloseHandle(file);
+            return false;
+        }
+
+        HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping == NULL) {
+            std::cout << "Could not create file mapping: " << filename << std::endl;
+            CloseHandle(file);
+            return false;
+        }
+
+        const void* address = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (address == NULL) {
+            std::cout << "Could not map view of file: " << filename << std::endl;
+            CloseHandle(mapping);
+            CloseHandle(file);
+            return false;
+        }
+
+        fileHandle = file;
+        mappingHandle = mapping;
+        bytes = static_cast<const char*>(address);
+        length = static_cast<size_t>(fileSize.QuadPart);
+
+        return true;
+    }
+
+    void MappedFile::close() {
+        if (bytes != nullptr) {
+            UnmapViewOfFile(bytes);
+        }
+        if (mappingHandle != nullptr) {
+            CloseHandle(mappingHandle);
+        }
+        if (fileHandle != nullptr) {
+            CloseHandle(fileHandle);
+        }
+
+        bytes = nullptr;
+        length = 0;
+        mappingHandle = nullptr;
+        fileHandle = nullptr;
+    }
+#else
+    bool MappedFile::open(const std::string& filename) {
+        close();
+
+        int file = ::open(filename.c_str(), O_RDONLY);
+        if (file < 0) {
+            std::cout << "Could not open file for mapping: " << filename << std::endl;
+            return false;
+        }
+
+        struct stat fileStatus;
+        if (fstat(file, &fileStatus) != 0 || fileStatus.st_size == 0) {
+            std::cout << "Could not map empty file: " << filename << std::endl;
+            ::close(file);
+            return false;
+        }
+
+        void* address = mmap(nullptr, static_cast<size_t>(fileStatus.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+
+        // The mapping keeps its own reference to the file
+        ::close(file);
+
+        if (address == MAP_FAILED) {
+            std::cout << "Could not map file: " << filename << std::endl;
+            return false;
+        }
+
+        bytes = static_cast<const char*>(address);
+        length = static_cast<size_t>(fileStatus.st_size);
+
+        return true;
+    }
+
+    void MappedFile::close() {
+        if (bytes != nullptr) {
+            munmap(const_cast<char*>(bytes), length);
+        }
+
+        bytes = nullptr;
+        length = 0;
+    }
+#endif
+
+    bool MappedFile::contains(const LumpData& lumpData) const {
+        if (lumpData.offset < 0 || lumpData.length < 0) {
+            return false;
+        }
+
+        return static_cast<size_t>(lumpData.offset) + static_cast<size_t>(lumpData.length) <= length;
+    }
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include "lumps.h"
+#include "lumpView.h"
+
+namespace BSP {
+    // Read-only memory mapping of a whole file.
+    // Every LumpView handed out by view() points straight into the mapping, so
+    // the MappedFile must stay open for as long as those views are in use.
+    class MappedFile {
+    public:
+        MappedFile() = default;
+        ~MappedFile();
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        bool open(const std::string& filename);
+        void close();
+
+        bool isOpen() const { return bytes != nullptr; }
+        const char* data() const { return bytes; }
+        size_t size() const { return length; }
+
+        // Check if the lump lies entirely inside the mapped file
+        bool contains(const LumpData& lumpData) const;
+
+        // Typed view of a lump, empty if the lump is out of bounds
+        template <typename T>
+        LumpView<T> view(const LumpData& lumpData) const {
+            if (!contains(lumpData)) {
+                return LumpView<T>();
+            }
+
+            return LumpView<T>(reinterpret_cast<const T*>(bytes + lumpData.offset),
+                lumpData.length / sizeof(T));
+        }
+
+    private:
+        const char* bytes = nullptr;
+        size_t length = 0;
+
+#ifdef _WIN32
+        void* fileHandle = nullptr;
+        void* mappingHandle = nullptr;
+#endif
+    };
+}
@@ -0,0 +1,37 @@
+#include "models.h"
+#include "transcode.h"
+#include "utils.h"
+
+namespace BSP {
+    // The max bound is followed by the face index, so the wide helper never leaves the record
+    void Models::transcode(const Model* source, Model* destination, size_t count) {
+        Transcode::records(source, destination, count, [](Model& model, bool) {
+            Transcode::boxWide(&model.min[0], &model.max[0]);
+        });
+    }
+
+    void Models::validate() {
+        for (const auto& model : getData()) {
+            warning_assert(model.getFace() >= 0, "Face index is negative.");
+            warning_assert(model.getNumOfFaces() >= 0, "Number of faces is negative.");
+            warning_assert(model.getBrush() >= 0, "Brush index is negative.");
+            warning_assert(model.getNumOfBrushes() >= 0, "Number of brushes is negative.");
+            warning_assert(model.getMin()[0] <= model.getMax()[0] &&
+                model.getMin()[1] <= model.getMax()[1] &&
+                model.getMin()[2] <= model.getMax()[2], "Invalid bounding box.");
+        }
+    }
+
+    void Models::displayData() const {
+        std::cout << "Displaying Model Data:" << std::endl;
+        int count = 0;
+        for (const auto& model : getData()) {
+            std::cout << "Model " << count << ": " << std::endl;
+            std::cout << "  Min: (" << model.getMin().x() << ", " << model.getMin().y() << ", " << model.getMin().z() << ")" << std::endl;
+            std::cout << "  Max: (" << model.getMax().x() << ", " << model.getMax().y() << ", " << model.getMax().z() << ")" << std::endl;
+            std::cout << "  Faces: " << model.getFace() << " + " << model.getNumOfFaces() << std::endl;
+            std::cout << "  Brushes: " << model.getBrush() << " + " << model.getNumOfBrushes() << std::endl;
+            count++;
+        }
+    }
+}
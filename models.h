@@ -0,0 +1,52 @@
+#pragma once
+
+#include "BSPElement.h"
+#include "boundingBox.h"
+
+/*
+The models lump describes the world model (always model 0) and the brush entities of the map, like
+doors, platforms and movers ("model" "*3" in the entity lump refers to model 3). Each model owns a
+contiguous range of faces and of brushes, so submodels can be drawn, culled and moved on their own.
+*/
+
+namespace BSP {
+    class Model {
+    public:
+        // Accessor (getter) methods
+        const Vec3f& getMin() const { return min; }
+        const Vec3f& getMax() const { return max; }
+        BoundingBox getBounds() const { return BoundingBox{ min, max }; }
+        int getFace() const { return face; }
+        int getNumOfFaces() const { return numOfFaces; }
+        int getBrush() const { return brush; }
+        int getNumOfBrushes() const { return numOfBrushes; }
+
+        // Mutator (setter) methods
+        void setMin(const Vec3f& newMin) { min = newMin; }
+        void setMax(const Vec3f& newMax) { max = newMax; }
+
+        Model() : face(0), numOfFaces(0), brush(0), numOfBrushes(0) {}
+
+        ~Model() = default;
+
+    private:
+        friend class Models;
+
+        Vec3f min;              // The min position of the bounding box
+        Vec3f max;              // The max position of the bounding box
+        int face;               // The first face of the model
+        int numOfFaces;         // The number of faces of the model
+        int brush;              // The first brush of the model
+        int numOfBrushes;       // The number of brushes of the model
+    };
+
+    class Models : public BSP::Element<Model> {
+    public:
+        void validate() override;
+        void displayData() const override;
+
+    protected:
+        bool isTranscoded() const override { return true; }
+        void transcode(const Model* source, Model* destination, size_t count) override;
+    };
+}
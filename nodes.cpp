@@ -1,9 +1,20 @@
 #include "Nodes.h"
+#include "transcode.h"
 #include "utils.h"
 
 namespace BSP {
+    // The bounds end the record, so the last node can't use the wide helper
+    void Nodes::transcode(const Node* source, Node* destination, size_t count) {
+        Transcode::records(source, destination, count, [](Node& node, bool hasNext) {
+            if (hasNext)
+                Transcode::boxWide(&node.min[0], &node.max[0]);
+            else
+                Transcode::box(&node.min[0], &node.max[0]);
+        });
+    }
+
     void Nodes::validate() {
-        for (const auto& node : elements) {
+        for (const auto& node : getData()) {
             warning_assert(node.getPlane() >= 0, "Plane is negative.");
 
             warning_assert(node.getFront() >= -1, "Front is less than -1.");
@@ -20,7 +31,7 @@ namespace BSP {
     void Nodes::displayData() const {
         std::cout << "Displaying Node Data:" << std::endl;
         int count = 1;
-        for (const auto& node : elements) {
+        for (const auto& node : getData()) {
             std::cout << "Node " << count << ": " << std::endl;
             std::cout << "  Plane: " << node.getPlane() << std::endl;
             std::cout << "  Front: " << node.getFront() << std::endl;
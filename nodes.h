@@ -30,6 +30,8 @@ namespace BSP {
         void setMax(const Vec3i& newMax) { max = newMax; }
 
     private:
+        friend class Nodes;
+
         int plane;     // The index into the planes array
         int front;     // The child index for the front node
         int back;      // The child index for the back node
@@ -41,5 +43,9 @@ namespace BSP {
     public:
         void validate() override;
         void displayData() const override;
+
+    protected:
+        bool isTranscoded() const override { return true; }
+        void transcode(const Node* source, Node* destination, size_t count) override;
     };
 }
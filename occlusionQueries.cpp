@@ -0,0 +1,164 @@
+#include <algorithm>
+
+#include "occlusionQueries.h"
+#include "glStateCache.h"
+#include "cameraUniforms.h"
+
+namespace BSP {
+    static const char* vertexShaderSource = "#version 330 core\n"
+        CAMERA_UNIFORM_BLOCK
+        "layout (location = 0) in vec3 aPos;\n"
+        "void main()\n"
+        "{\n"
+        "   gl_Position = viewProjection * vec4(aPos, 1.0);\n"
+        "}\0";
+
+    // Nothing is written, only the samples that pass the depth test count
+    static const char* fragmentShaderSource = "#version 330 core\n"
+        "out vec4 FragColor;\n"
+        "void main()\n"
+        "{\n"
+        "   FragColor = vec4(1.0);\n"
+        "}\n\0";
+
+    OcclusionQueries::~OcclusionQueries() {
+        if (program == 0)
+            return;
+
+        deleteQueries();
+
+        glDeleteVertexArrays(1, &vao);
+        glDeleteBuffers(1, &vbo);
+        glDeleteBuffers(1, &ebo);
+        GLStateCache::shared().forgetProgram(program);
+        glDeleteProgram(program);
+    }
+
+    void OcclusionQueries::deleteQueries() {
+        for (const Object& object : objects)
+            glDeleteQueries(1, &object.query);
+
+        objects.clear();
+        revealed.clear();
+        requested.clear();
+    }
+
+    void OcclusionQueries::create(int objectCount) {
+        deleteQueries();
+
+        objects.assign(std::max(objectCount, 0), Object());
+        for (Object& object : objects)
+            glGenQueries(1, &object.query);
+
+        if (program != 0)
+            return;
+
+        // Twelve triangles over the corners of BoundingBox::corner(), the winding does not matter
+        const GLuint boxIndices[] = {
+            0, 2, 1, 1, 2, 3,   4, 5, 6, 5, 7, 6,   // -z, +z
+            0, 1, 4, 1, 5, 4,   2, 6, 3, 3, 6, 7,   // -y, +y
+            0, 4, 2, 2, 4, 6,   1, 3, 5, 3, 7, 5    // -x, +x
+        };
+
+        GLStateCache& state = GLStateCache::shared();
+
+        glGenVertexArrays(1, &vao);
+        glGenBuffers(1, &vbo);
+        glGenBuffers(1, &ebo);
+
+        state.bindVertexArray(vao);
+        state.bindBuffer(GL_ARRAY_BUFFER, vbo);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(0);
+
+        // The element buffer binding is part of the VAO
+        state.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(boxIndices), boxIndices, GL_STATIC_DRAW);
+        state.bindVertexArray(0);
+
+        GLuint vertexShader = compileShader(GL_VERTEX_SHADER, vertexShaderSource, "Occlusion vertex shader");
+        GLuint fragmentShader = compileShader(GL_FRAGMENT_SHADER, fragmentShaderSource, "Occlusion fragment shader");
+
+        program = linkProgram(vertexShader, fragmentShader, "Occlusion shader program");
+
+        CameraUniforms::bindProgram(program);
+
+        checkGLError("OcclusionQueries create");
+    }
+
+    void OcclusionQueries::collectResults() {
+        revealed.clear();
+
+        for (int i = 0; i < static_cast<int>(objects.size()); i++) {
+            Object& object = objects[i];
+            if (!object.pending)
+                continue;
+
+            GLint available = 0;
+            glGetQueryObjectiv(object.query, GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                continue;
+
+            GLuint anySamples = 0;
+            glGetQueryObjectuiv(object.query, GL_QUERY_RESULT, &anySamples);
+            object.pending = false;
+
+            if (anySamples != 0 && !object.visible)
+                revealed.push_back(i);
+            object.visible = anySamples != 0;
+        }
+    }
+
+    void OcclusionQueries::request(int object, const BoundingBox& bounds) {
+        if (objects[object].pending)
+            return;
+
+        // Marked right away, so requesting the same object twice in a frame queries it once
+        objects[object].pending = true;
+        requested.push_back(object);
+
+        for (int i = 0; i < 8; i++) {
+            Vec3f corner = bounds.corner(i);
+            corners.push_back(corner.x());
+            corners.push_back(corner.y());
+            corners.push_back(corner.z());
+        }
+    }
+
+    int OcclusionQueries::issue() {
+        int issued = static_cast<int>(requested.size());
+        if (issued == 0)
+            return 0;
+
+        GLStateCache& state = GLStateCache::shared();
+
+        // Orphaned every frame and only grown, like the debug draw buffer
+        size_t bytes = corners.size() * sizeof(float);
+        capacity = std::max(bytes, capacity);
+        state.bindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBufferData(GL_ARRAY_BUFFER, capacity, nullptr, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, corners.data());
+
+        state.useProgram(program);
+        state.bindVertexArray(vao);
+        state.colorMask(false);
+        state.depthMask(false);
+        state.depthFunc(GL_LEQUAL);
+
+        for (int i = 0; i < issued; i++) {
+            glBeginQuery(GL_ANY_SAMPLES_PASSED, objects[requested[i]].query);
+            glDrawElementsBaseVertex(GL_TRIANGLES, 36, GL_UNSIGNED_INT, (void*)0, i * 8);
+            glEndQuery(GL_ANY_SAMPLES_PASSED);
+        }
+
+        state.depthFunc(GL_LESS);
+        state.depthMask(true);
+        state.colorMask(true);
+        state.bindVertexArray(0);
+        state.useProgram(0);
+
+        requested.clear();
+        corners.clear();
+        return issued;
+    }
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <vector>
+
+#include "GL_Utils.h"
+#include "boundingBox.h"
+
+namespace BSP {
+    /*
+    GL_ANY_SAMPLES_PASSED queries against the bounding boxes of a set of objects (BSP nodes and
+    leaves for the loader). Boxes are drawn at the end of the frame, depth tested against everything
+    drawn before but without writing depth or color.
+
+    Answers are only read once the GPU has them, usually one or two frames later, so culling never
+    waits: an object keeps the visibility it had until a newer answer arrives. All boxes of a frame
+    go into one streaming buffer and share one index buffer.
+    */
+    class OcclusionQueries {
+    public:
+        OcclusionQueries() = default;
+        ~OcclusionQueries();
+
+        OcclusionQueries(const OcclusionQueries&) = delete;
+        OcclusionQueries& operator=(const OcclusionQueries&) = delete;
+
+        // One query per object, every object starts visible. Needs a GL context. Calling it again, for
+        // the nodes and leaves of a new map, replaces every query and keeps the program and buffers.
+        void create(int objectCount);
+        bool isCreated() const { return program != 0; }
+        int size() const { return static_cast<int>(objects.size()); }
+
+        // Read every answer that arrived since the last call. Objects that turned visible are listed
+        // in getRevealed() until the next call.
+        void collectResults();
+        const std::vector<int>& getRevealed() const { return revealed; }
+
+        bool isVisible(int object) const { return objects[object].visible; }
+        void setVisible(int object, bool visible) { objects[object].visible = visible; }
+
+        // Test the box at the end of the frame. Ignored while the object still has a query in flight.
+        void request(int object, const BoundingBox& bounds);
+
+        // Draw the box of every request inside its query, returns the number of queries issued.
+        // Leaves no program or VAO bound and depth and color writes on.
+        int issue();
+
+    private:
+        struct Object {
+            GLuint query = 0;
+            bool visible = true;
+            bool pending = false;       // Issued, answer not read yet
+        };
+
+        std::vector<Object> objects;
+        std::vector<int> revealed;
+
+        std::vector<int> requested;                 // Objects to test this frame
+        std::vector<float> corners;                 // Eight corners per requested box
+
+        GLuint vao = 0;
+        GLuint vbo = 0;
+        GLuint ebo = 0;
+        GLuint program = 0;
+        size_t capacity = 0;                        // Of vbo, in bytes
+
+        void deleteQueries();
+    };
+}
@@ -0,0 +1,349 @@
+#include <algorithm>
+#include <cmath>
+
+#include "occlusionRasterizer.h"
+#include "threadPool.h"
+#include "simd.h"
+
+namespace BSP {
+    // Quake III content and surface flags of a texture, only solid opaque faces that are drawn occlude
+    static const int CONTENTS_SOLID = 0x1;
+    static const int CONTENTS_TRANSLUCENT = 0x20000000;
+    static const int SURF_NODRAW = 0x80;
+
+    // Rows rasterized by one pool task
+    static const int BAND_HEIGHT = 16;
+
+    // Corners closer to the camera plane than this are treated as behind it
+    static const float MIN_W = 1e-5f;
+
+    OcclusionRasterizer::OcclusionRasterizer() {
+        setResolution(DEFAULT_WIDTH, DEFAULT_HEIGHT);
+    }
+
+    void OcclusionRasterizer::build(const Faces& faces, const Vertices& vertices, const IndexedData& indices,
+        const Textures& textures, const Models& models, int maxOccluders, float minArea) {
+        triangles.clear();
+        occluders = 0;
+        rendered = false;
+
+        LumpView<Face> allFaces = faces.getData();
+        LumpView<Vertex> allVertices = vertices.getData();
+        LumpView<Texture> allTextures = textures.getData();
+        LumpView<int> allIndices = indices.getView();
+
+        struct Candidate {
+            int face;
+            float area;
+        };
+        std::vector<Candidate> candidates;
+
+        int firstFace = 0;
+        int lastFace = static_cast<int>(allFaces.size());
+        LumpView<Model> allModels = models.getData();
+        if (!allModels.empty()) {
+            firstFace = std::max(allModels[0].getFace(), 0);
+            lastFace = std::min(allModels[0].getFace() + allModels[0].getNumOfFaces(), lastFace);
+        }
+
+        for (int faceIndex = firstFace; faceIndex < lastFace; faceIndex++) {
+            const Face& face = allFaces[faceIndex];
+            if (face.getType() != FACE_POLYGON || face.getNumOfIndices() < 3)
+                continue;
+
+            if (face.getTextureID() < 0 || face.getTextureID() >= static_cast<int>(allTextures.size()))
+                continue;
+
+            const Texture& texture = allTextures[face.getTextureID()];
+            if (!(texture.textureType & CONTENTS_SOLID) || (texture.textureType & CONTENTS_TRANSLUCENT) || (texture.flags & SURF_NODRAW))
+                continue;
+
+            if (face.getStartIndex() < 0 || face.getStartIndex() + face.getNumOfIndices() > static_cast<int>(allIndices.size()))
+                continue;
+
+            float area = 0.0f;
+            bool valid = true;
+            for (int i = 0; i + 2 < face.getNumOfIndices() && valid; i += 3) {
+                Vec3f corners[3];
+                for (int k = 0; k < 3; k++) {
+                    int vertexIndex = face.getStartVertIndex() + allIndices[face.getStartIndex() + i + k];
+                    if (vertexIndex < 0 || vertexIndex >= static_cast<int>(allVertices.size())) {
+                        valid = false;
+                        break;
+                    }
+                    corners[k] = allVertices[vertexIndex].getPosition();
+                }
+
+                if (valid)
+                    area += 0.5f * Vec3f(corners[1] - corners[0]).cross(Vec3f(corners[2] - corners[0])).length();
+            }
+
+            if (valid && area >= minArea)
+                candidates.push_back(Candidate{ faceIndex, area });
+        }
+
+        std::sort(candidates.begin(), candidates.end(),
+            [](const Candidate& a, const Candidate& b) { return a.area > b.area || (a.area == b.area && a.face < b.face); });
+
+        if (static_cast<int>(candidates.size()) > maxOccluders)
+            candidates.resize(std::max(maxOccluders, 0));
+
+        for (const Candidate& candidate : candidates) {
+            const Face& face = allFaces[candidate.face];
+            for (int i = 0; i + 2 < face.getNumOfIndices(); i += 3) {
+                for (int k = 0; k < 3; k++) {
+                    Vec3f position = allVertices[face.getStartVertIndex() + allIndices[face.getStartIndex() + i + k]].getPosition();
+                    triangles.push_back(position.x());
+                    triangles.push_back(position.y());
+                    triangles.push_back(position.z());
+                }
+            }
+        }
+
+        occluders = static_cast<int>(candidates.size());
+    }
+
+    void OcclusionRasterizer::setResolution(int width, int height) {
+        this->width = (std::max(width, 4) + 3) & ~3;
+        this->height = std::max(height, 1);
+        depth.assign(static_cast<size_t>(this->width) * this->height, 0.0f);
+        rendered = false;
+    }
+
+    void OcclusionRasterizer::render(const Mat4<float>& viewProjection) {
+        this->viewProjection = viewProjection;
+        rendered = true;
+        std::fill(depth.begin(), depth.end(), 0.0f);
+
+        const float* m = viewProjection.getData();
+        size_t vertexCount = triangles.size() / 3;
+        clipVertices.resize(vertexCount * 4);
+
+        for (size_t i = 0; i < vertexCount; i++) {
+            const float* p = &triangles[i * 3];
+            for (int row = 0; row < 4; row++)
+                clipVertices[i * 4 + row] = m[row * 4] * p[0] + m[row * 4 + 1] * p[1] + m[row * 4 + 2] * p[2] + m[row * 4 + 3];
+        }
+
+        // Setup is serial and cheap next to the rasterization
+        screenTriangles.clear();
+        for (size_t t = 0; t < vertexCount / 3; t++) {
+            const float* v[3] = { &clipVertices[t * 12], &clipVertices[t * 12 + 4], &clipVertices[t * 12 + 8] };
+
+            // Skip triangles entirely outside one side of the view
+            int sharedOutside = 0x1F;
+            for (int k = 0; k < 3; k++) {
+                float x = v[k][0], y = v[k][1], z = v[k][2], w = v[k][3];
+                int outside = 0;
+                if (x < -w) outside |= 1;
+                if (x > w) outside |= 2;
+                if (y < -w) outside |= 4;
+                if (y > w) outside |= 8;
+                if (z < -w) outside |= 16;
+                sharedOutside &= outside;
+            }
+            if (sharedOutside != 0)
+                continue;
+
+            // Clip against the near plane (z >= -w), which leaves a triangle or a quad
+            float polygon[4][4];
+            int count = 0;
+            for (int k = 0; k < 3; k++) {
+                const float* a = v[k];
+                const float* b = v[(k + 1) % 3];
+                float da = a[2] + a[3];
+                float db = b[2] + b[3];
+
+                if (da >= 0.0f)
+                    std::copy(a, a + 4, polygon[count++]);
+
+                if ((da >= 0.0f) != (db >= 0.0f)) {
+                    float t = da / (da - db);
+                    for (int c = 0; c < 4; c++)
+                        polygon[count][c] = a[c] + (b[c] - a[c]) * t;
+                    count++;
+                }
+            }
+
+            for (int k = 1; k + 1 < count; k++)
+                setupTriangle(polygon[0], polygon[k], polygon[k + 1]);
+        }
+
+        int bands = (height + BAND_HEIGHT - 1) / BAND_HEIGHT;
+        ThreadPool::shared().parallelFor(bands, [this](int band) {
+            rasterizeBand(band * BAND_HEIGHT, std::min((band + 1) * BAND_HEIGHT, height));
+        });
+    }
+
+    void OcclusionRasterizer::setupTriangle(const float* v0, const float* v1, const float* v2) {
+        const float* v[3] = { v0, v1, v2 };
+        float x[3], y[3], z[3];
+
+        for (int k = 0; k < 3; k++) {
+            if (v[k][3] < MIN_W)
+                return;
+
+            float inverseW = 1.0f / v[k][3];
+            x[k] = (v[k][0] * inverseW * 0.5f + 0.5f) * width;
+            y[k] = (v[k][1] * inverseW * 0.5f + 0.5f) * height;
+            z[k] = inverseW;
+        }
+
+        float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+        if (std::fabs(area) < 1e-6f)
+            return;
+
+        // Counter-clockwise on screen, so the inside is left of every edge
+        if (area < 0.0f) {
+            std::swap(x[1], x[2]);
+            std::swap(y[1], y[2]);
+            std::swap(z[1], z[2]);
+            area = -area;
+        }
+
+        ScreenTriangle triangle;
+        triangle.minX = std::max(0, static_cast<int>(std::floor(std::min({ x[0], x[1], x[2] }))));
+        triangle.maxX = std::min(width - 1, static_cast<int>(std::ceil(std::max({ x[0], x[1], x[2] }))));
+        triangle.minY = std::max(0, static_cast<int>(std::floor(std::min({ y[0], y[1], y[2] }))));
+        triangle.maxY = std::min(height - 1, static_cast<int>(std::ceil(std::max({ y[0], y[1], y[2] }))));
+        if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+            return;
+
+        for (int i = 0; i < 3; i++) {
+            int j = (i + 1) % 3;
+            triangle.a[i] = y[i] - y[j];
+            triangle.b[i] = x[j] - x[i];
+            triangle.c[i] = -(triangle.a[i] * x[i] + triangle.b[i] * y[i]);
+        }
+
+        triangle.zx = ((z[1] - z[0]) * (y[2] - y[0]) - (z[2] - z[0]) * (y[1] - y[0])) / area;
+        triangle.zy = ((x[1] - x[0]) * (z[2] - z[0]) - (x[2] - x[0]) * (z[1] - z[0])) / area;
+        triangle.z0 = z[0] - triangle.zx * x[0] - triangle.zy * y[0];
+
+        screenTriangles.push_back(triangle);
+    }
+
+    void OcclusionRasterizer::rasterizeBand(int firstRow, int lastRow) {
+        for (const ScreenTriangle& triangle : screenTriangles) {
+            int y0 = std::max(triangle.minY, firstRow);
+            int y1 = std::min(triangle.maxY, lastRow - 1);
+            int x0 = triangle.minX & ~3;
+
+            for (int y = y0; y <= y1; y++) {
+                float py = y + 0.5f;
+                float* row = &depth[static_cast<size_t>(y) * width];
+
+                // Per row parts of the edge and depth equations, the same in both paths
+                float rowEdges[3], rowDepth = triangle.zy * py + triangle.z0;
+                for (int i = 0; i < 3; i++)
+                    rowEdges[i] = triangle.b[i] * py + triangle.c[i];
+
+#if BSP_SIMD_SSE2
+                const __m128 zero = _mm_setzero_ps();
+                const __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+                const __m128 a0 = _mm_set1_ps(triangle.a[0]), a1 = _mm_set1_ps(triangle.a[1]), a2 = _mm_set1_ps(triangle.a[2]);
+                const __m128 e0 = _mm_set1_ps(rowEdges[0]), e1 = _mm_set1_ps(rowEdges[1]), e2 = _mm_set1_ps(rowEdges[2]);
+                const __m128 zx = _mm_set1_ps(triangle.zx), zRow = _mm_set1_ps(rowDepth);
+
+                for (int x = x0; x <= triangle.maxX; x += 4) {
+                    __m128 px = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), offsets);
+
+                    __m128 inside = _mm_and_ps(
+                        _mm_and_ps(_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a0, px), e0), zero),
+                            _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a1, px), e1), zero)),
+                        _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a2, px), e2), zero));
+                    if (_mm_movemask_ps(inside) == 0)
+                        continue;
+
+                    // The nearest surface has the largest 1 / w
+                    __m128 stored = _mm_loadu_ps(row + x);
+                    __m128 nearest = _mm_max_ps(stored, _mm_add_ps(_mm_mul_ps(zx, px), zRow));
+                    _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, stored)));
+                }
+#else
+                for (int x = x0; x <= triangle.maxX; x += 4) {
+                    for (int lane = 0; lane < 4; lane++) {
+                        float px = static_cast<float>(x) + (lane + 0.5f);
+
+                        if (triangle.a[0] * px + rowEdges[0] >= 0.0f &&
+                            triangle.a[1] * px + rowEdges[1] >= 0.0f &&
+                            triangle.a[2] * px + rowEdges[2] >= 0.0f) {
+                            row[x + lane] = std::max(row[x + lane], triangle.zx * px + rowDepth);
+                        }
+                    }
+                }
+#endif
+            }
+        }
+    }
+
+    bool OcclusionRasterizer::isVisible(const BoundingBox& bounds) const {
+        if (!rendered)
+            return true;
+
+        const float* m = viewProjection.getData();
+        float minX = static_cast<float>(width), maxX = 0.0f;
+        float minY = static_cast<float>(height), maxY = 0.0f;
+        float nearest = 0.0f;
+        int sharedOutside = 0x1F;
+
+        for (int i = 0; i < 8; i++) {
+            Vec3f p = bounds.corner(i);
+            float x = m[0] * p.x() + m[1] * p.y() + m[2] * p.z() + m[3];
+            float y = m[4] * p.x() + m[5] * p.y() + m[6] * p.z() + m[7];
+            float z = m[8] * p.x() + m[9] * p.y() + m[10] * p.z() + m[11];
+            float w = m[12] * p.x() + m[13] * p.y() + m[14] * p.z() + m[15];
+
+            int outside = 0;
+            if (x < -w) outside |= 1;
+            if (x > w) outside |= 2;
+            if (y < -w) outside |= 4;
+            if (y > w) outside |= 8;
+            if (z < -w) outside |= 16;
+            sharedOutside &= outside;
+
+            // A box reaching behind the camera can cover any part of the screen
+            if (w < MIN_W)
+                return true;
+
+            float inverseW = 1.0f / w;
+            float sx = (x * inverseW * 0.5f + 0.5f) * width;
+            float sy = (y * inverseW * 0.5f + 0.5f) * height;
+            minX = std::min(minX, sx);
+            maxX = std::max(maxX, sx);
+            minY = std::min(minY, sy);
+            maxY = std::max(maxY, sy);
+            nearest = std::max(nearest, inverseW);
+        }
+
+        if (sharedOutside != 0)
+            return false;
+
+        // One pixel of margin for the occluder edges sampled at pixel centers
+        int x0 = std::max(0, static_cast<int>(std::floor(minX)) - 1) & ~3;
+        int x1 = std::min(width - 1, static_cast<int>(std::ceil(maxX)) + 1);
+        int y0 = std::max(0, static_cast<int>(std::floor(minY)) - 1);
+        int y1 = std::min(height - 1, static_cast<int>(std::ceil(maxY)) + 1);
+
+        for (int y = y0; y <= y1; y++) {
+            const float* row = &depth[static_cast<size_t>(y) * width];
+
+#if BSP_SIMD_SSE2
+            const __m128 boxDepth = _mm_set1_ps(nearest);
+            for (int x = x0; x <= x1; x += 4) {
+                if (_mm_movemask_ps(_mm_cmplt_ps(_mm_loadu_ps(row + x), boxDepth)) != 0)
+                    return true;
+            }
+#else
+            for (int x = x0; x <= x1; x += 4) {
+                for (int lane = 0; lane < 4; lane++) {
+                    if (row[x + lane] < nearest)
+                        return true;
+                }
+            }
+#endif
+        }
+
+        return false;
+    }
+}
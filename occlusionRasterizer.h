@@ -0,0 +1,81 @@
+#pragma once
+
+#include <vector>
+
+#include "boundingBox.h"
+#include "faces.h"
+#include "vertices.h"
+#include "textures.h"
+#include "indexedData.h"
+#include "models.h"
+#include "matrix.h"
+
+namespace BSP {
+    /*
+    Software occlusion culling. The largest opaque FACE_POLYGON faces of the map are the occluders;
+    render() rasterizes them into a small depth buffer on the CPU, and isVisible() tells whether a box
+    could still show through. Nothing here calls GL, so it also runs in headless loads.
+
+    The rows of the buffer are split into bands that the shared ThreadPool rasterizes in parallel,
+    four pixels at a time with SSE2 (the scalar path gives the same depth buffer).
+
+    Occluders are sampled at pixel centers, so they can cover a pixel they only partly overlap.
+    Tested boxes are grown by one pixel on each side to make up for it.
+    */
+    class OcclusionRasterizer {
+    public:
+        static const int DEFAULT_WIDTH = 256;
+        static const int DEFAULT_HEIGHT = 144;
+
+        OcclusionRasterizer();
+
+        // Keep the maxOccluders largest faces with an area of at least minArea (square world units).
+        // Only faces of model 0 occlude, the other models can move. Without models every face is a world face.
+        void build(const Faces& faces, const Vertices& vertices, const IndexedData& indices, const Textures& textures,
+            const Models& models, int maxOccluders = 256, float minArea = 4096.0f);
+
+        // Width is rounded up to a multiple of 4
+        void setResolution(int width, int height);
+
+        // Clear the depth buffer and rasterize the occluders seen through viewProjection (row-major,
+        // like the camera matrices)
+        void render(const Mat4<float>& viewProjection);
+
+        // False when the box is outside the view or hidden behind the occluders of the last render()
+        bool isVisible(const BoundingBox& bounds) const;
+
+        int getOccluderCount() const { return occluders; }
+        int getTriangleCount() const { return static_cast<int>(triangles.size() / 9); }
+        int getRasterizedTriangleCount() const { return static_cast<int>(screenTriangles.size()); }
+        int getWidth() const { return width; }
+        int getHeight() const { return height; }
+
+        // 1 / w of the nearest occluder of each pixel, 0 where nothing was drawn. The reciprocal is
+        // affine across a triangle on screen and keeps its precision far away, unlike z / w.
+        // Rows go up from the bottom of the screen.
+        const std::vector<float>& getDepth() const { return depth; }
+
+    private:
+        // Edge functions a * x + (b * y + c) are >= 0 inside, 1 / w is zx * x + (zy * y + z0)
+        struct ScreenTriangle {
+            int minX, maxX, minY, maxY;     // Inclusive pixel bounds, clamped to the buffer
+            float a[3], b[3], c[3];
+            float zx, zy, z0;
+        };
+
+        std::vector<float> triangles;       // Nine floats per occluder triangle, world space
+        int occluders = 0;
+
+        int width = 0;
+        int height = 0;
+        std::vector<float> depth;
+        Mat4<float> viewProjection;
+        bool rendered = false;
+
+        std::vector<float> clipVertices;    // Four floats per triangle corner, for the current render()
+        std::vector<ScreenTriangle> screenTriangles;
+
+        void setupTriangle(const float* v0, const float* v1, const float* v2);
+        void rasterizeBand(int firstRow, int lastRow);
+    };
+}
@@ -0,0 +1,229 @@
+#include <algorithm>
+
+#include "patchLod.h"
+
+namespace BSP {
+    // Quadratic patches nearer than this are taken at this distance, the camera may be inside the bounds
+    static const float MIN_DISTANCE = 1.0f;
+
+    void PatchLod::build(const Faces& faces, const Vertices& vertices, int tessellationLevel) {
+        this->tessellationLevel = tessellationLevel;
+        levels.clear();
+        patchFaces.assign(faces.size(), PatchFace());
+        quadPatches.clear();
+        indices.clear();
+        combinations.clear();
+
+        if (tessellationLevel < 1)
+            return;
+
+        for (int level = tessellationLevel; ; level /= 2) {
+            levels.push_back(level);
+            if (level % 2 != 0)
+                break;
+        }
+        if (levels.back() != 1)
+            levels.push_back(1);
+
+        LumpView<Face> allFaces = faces.getData();
+        LumpView<Vertex> allVertices = vertices.getData();
+        const int patchVertices = (tessellationLevel + 1) * (tessellationLevel + 1);
+        int firstVertex = 0;
+
+        // Same layout as the patch buffers: faces in order, their quadratic patches row by row
+        for (int faceIndex = 0; faceIndex < static_cast<int>(allFaces.size()); faceIndex++) {
+            const Face& face = allFaces[faceIndex];
+            if (face.getType() != FACE_PATCH)
+                continue;
+
+            int controlWidth = face.getBezierPatchesSize()[0];
+            PatchFace& patch = patchFaces[faceIndex];
+            patch.firstQuadPatch = static_cast<int>(quadPatches.size());
+            patch.width = std::max((controlWidth - 1) / 2, 0);
+            patch.height = std::max((face.getBezierPatchesSize()[1] - 1) / 2, 0);
+            patch.firstVertex = firstVertex;
+            firstVertex += patch.width * patch.height * patchVertices;
+
+            for (int y = 0; y < patch.height; y++) {
+                for (int x = 0; x < patch.width; x++) {
+                    Vec3f points[9];
+                    for (int r = 0; r < 3; r++) {
+                        for (int c = 0; c < 3; c++) {
+                            int vertexIndex = face.getStartVertIndex() + (y * 2 * controlWidth + x * 2) + r * controlWidth + c;
+                            if (vertexIndex >= 0 && vertexIndex < static_cast<int>(allVertices.size()))
+                                points[r * 3 + c] = allVertices[vertexIndex].getPosition();
+                        }
+                    }
+
+                    QuadPatch quadPatch;
+                    Vec3f min = points[0], max = points[0];
+                    for (const Vec3f& point : points) {
+                        for (int i = 0; i < 3; i++) {
+                            min[i] = std::min(min[i], point[i]);
+                            max[i] = std::max(max[i], point[i]);
+                        }
+                    }
+                    quadPatch.center = (min + max) * 0.5f;
+                    quadPatch.radius = Vec3f(max - min).length() * 0.5f;
+
+                    // A quadratic Bezier cut in n segments strays at most |P0 - 2 P1 + P2| / (4 n^2)
+                    // from them, on both directions of the patch
+                    float rows = 0.0f, columns = 0.0f;
+                    for (int k = 0; k < 3; k++) {
+                        rows = std::max(rows, Vec3f(points[k * 3] - points[k * 3 + 1] * 2.0f + points[k * 3 + 2]).length());
+                        columns = std::max(columns, Vec3f(points[k] - points[3 + k] * 2.0f + points[6 + k]).length());
+                    }
+
+                    // The diagonal of each grid cell adds the twist, at most 4 |P00 - P01 - P10 + P11| / (4 n^2)
+                    // over the control cells. Saddles have straight rows and columns but still bend.
+                    float twist = 0.0f;
+                    for (int r = 0; r < 2; r++) {
+                        for (int c = 0; c < 2; c++) {
+                            int corner = r * 3 + c;
+                            twist = std::max(twist, Vec3f(points[corner] - points[corner + 1] - points[corner + 3] + points[corner + 4]).length());
+                        }
+                    }
+                    quadPatch.curvature = rows + columns + 4.0f * twist;
+
+                    quadPatches.push_back(quadPatch);
+                }
+            }
+        }
+
+        // Every level with every coarser (or equal) level on each edge
+        int count = static_cast<int>(levels.size());
+        combinations.assign(count * count * count * count * count, DrawRange{ 0, 0, 0 });
+        for (int level = 0; level < count; level++) {
+            int edges[4];
+            for (edges[0] = level; edges[0] < count; edges[0]++)
+                for (edges[1] = level; edges[1] < count; edges[1]++)
+                    for (edges[2] = level; edges[2] < count; edges[2]++)
+                        for (edges[3] = level; edges[3] < count; edges[3]++)
+                            buildCombination(level, edges);
+        }
+    }
+
+    // Edges are i = 0, i = full, j = 0 and j = full, see buildCombination()
+    int PatchLod::combination(int level, const int edges[4]) const {
+        int count = static_cast<int>(levels.size());
+        return (((level * count + edges[0]) * count + edges[1]) * count + edges[2]) * count + edges[3];
+    }
+
+    void PatchLod::buildCombination(int level, const int edges[4]) {
+        const int full = tessellationLevel;
+        const int step = full / levels[level];
+        const int first = static_cast<int>(indices.size());
+
+        // Grid point (i, j) of PatchTessellator, i along the control columns and j along
+        // the rows. Triangles turn the same way as the full tessellation, degenerate ones are dropped.
+        auto triangle = [this, full](int ai, int aj, int bi, int bj, int ci, int cj) {
+            int area = (bi - ai) * (cj - aj) - (ci - ai) * (bj - aj);
+            if (area == 0)
+                return;
+            if (area < 0) {
+                std::swap(bi, ci);
+                std::swap(bj, cj);
+            }
+
+            indices.push_back(static_cast<GLuint>(ai * (full + 1) + aj));
+            indices.push_back(static_cast<GLuint>(bi * (full + 1) + bj));
+            indices.push_back(static_cast<GLuint>(ci * (full + 1) + cj));
+        };
+
+        if (step == full) {
+            triangle(0, 0, full, 0, full, full);
+            triangle(0, 0, full, full, 0, full);
+        }
+        else {
+            // Regular grid one step away from every edge
+            for (int i = step; i < full - step; i += step) {
+                for (int j = step; j < full - step; j += step) {
+                    triangle(i, j, i + step, j, i + step, j + step);
+                    triangle(i, j, i + step, j + step, i, j + step);
+                }
+            }
+
+            // Each border strip zips its edge, sampled at the edge's step, to the first row of the grid.
+            // The strips meet on the diagonals from the corners.
+            for (int edge = 0; edge < 4; edge++) {
+                const int edgeStep = full / levels[edges[edge]];
+
+                // t along the edge, d inwards
+                auto point = [edge, full](int t, int d, int& i, int& j) {
+                    switch (edge) {
+                    case 0: i = d; j = t; break;
+                    case 1: i = full - d; j = t; break;
+                    case 2: i = t; j = d; break;
+                    default: i = t; j = full - d; break;
+                    }
+                };
+
+                int outer = 0;
+                int inner = step;
+                while (outer < full || inner < full - step) {
+                    int ai, aj, bi, bj, ci, cj;
+                    point(outer, 0, ai, aj);
+
+                    if (inner >= full - step || (outer < full && outer + edgeStep <= inner + step)) {
+                        point(outer + edgeStep, 0, bi, bj);
+                        point(inner, step, ci, cj);
+                        outer += edgeStep;
+                    }
+                    else {
+                        point(inner + step, step, bi, bj);
+                        point(inner, step, ci, cj);
+                        inner += step;
+                    }
+
+                    triangle(ai, aj, bi, bj, ci, cj);
+                }
+            }
+        }
+
+        combinations[combination(level, edges)] = DrawRange{ first, static_cast<int>(indices.size()) - first, 0 };
+    }
+
+    void PatchLod::select(int faceIndex, const Mat4<float>& transform, const Vec3f& cameraPosition, float errorScale,
+        std::vector<DrawRange>& ranges) {
+        const PatchFace& patch = patchFaces[faceIndex];
+        const int patchVertices = (tessellationLevel + 1) * (tessellationLevel + 1);
+        const int coarsest = static_cast<int>(levels.size()) - 1;
+        const float* m = transform.getData();
+
+        chosen.resize(patch.width * patch.height);
+        for (int i = 0; i < static_cast<int>(chosen.size()); i++) {
+            const QuadPatch& quadPatch = quadPatches[patch.firstQuadPatch + i];
+            const Vec3f& c = quadPatch.center;
+            Vec3f center(m[0] * c.x() + m[1] * c.y() + m[2] * c.z() + m[3],
+                m[4] * c.x() + m[5] * c.y() + m[6] * c.z() + m[7],
+                m[8] * c.x() + m[9] * c.y() + m[10] * c.z() + m[11]);
+            float distance = std::max((center - cameraPosition).length() - quadPatch.radius, MIN_DISTANCE);
+
+            // The error of level n projects to curvature / (4 n^2) * errorScale / distance
+            float needed = quadPatch.curvature * errorScale / (4.0f * distance);
+            int level = coarsest;
+            while (level > 0 && static_cast<float>(levels[level]) * levels[level] < needed)
+                level--;
+            chosen[i] = level;
+        }
+
+        for (int y = 0; y < patch.height; y++) {
+            for (int x = 0; x < patch.width; x++) {
+                int i = y * patch.width + x;
+                int level = chosen[i];
+
+                // A shared edge takes the coarser level of its two patches
+                int edges[4] = {
+                    x > 0 ? std::max(level, chosen[i - 1]) : level,
+                    x + 1 < patch.width ? std::max(level, chosen[i + 1]) : level,
+                    y > 0 ? std::max(level, chosen[i - patch.width]) : level,
+                    y + 1 < patch.height ? std::max(level, chosen[i + patch.width]) : level
+                };
+
+                DrawRange range = combinations[combination(level, edges)];
+                range.baseVertex = patch.firstVertex + i * patchVertices;
+                ranges.push_back(range);
+            }
+        }
+    }
+}
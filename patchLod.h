@@ -0,0 +1,67 @@
+#pragma once
+
+#include <vector>
+
+#include "GL_Utils.h"
+#include "drawRange.h"
+#include "faces.h"
+#include "vertices.h"
+#include "matrix.h"
+
+namespace BSP {
+    /*
+    Distance based level of detail of the tessellated patches. The patch buffers hold every quadratic
+    patch at the full tessellation level and a coarser level draws a subset of the same vertices, so
+    no vertex data is added. The levels are the full one halved while it stays even, then 1 (20, 10,
+    5 and 1 for the default of 20): the vertices of a level are always vertices of the finer ones.
+
+    Each quadratic patch takes the coarsest level whose error, the distance between the surface and
+    its triangles, projects to less than the allowed number of pixels. An edge shared by two quadratic
+    patches of the same face uses the coarser of both levels on both sides, and the border row of the
+    finer patch is stitched to it, so no crack opens between them. Edges between faces are not stitched.
+
+    One index list is built for every level and every combination of coarser edges. The lists index
+    the vertices of a single quadratic patch, the base vertex of a draw selects the patch.
+    */
+    class PatchLod {
+    public:
+        // Quadratic patches are read from the control points, like Loader::initializeBezierPatches()
+        void build(const Faces& faces, const Vertices& vertices, int tessellationLevel);
+        bool isBuilt() const { return !levels.empty(); }
+
+        const std::vector<int>& getLevels() const { return levels; }       // Finest first
+        const std::vector<GLuint>& getIndices() const { return indices; }  // For the element buffer
+        void releaseIndices() { indices = std::vector<GLuint>(); }         // Once they are uploaded
+
+        // Appends one range per quadratic patch of the face. errorScale is the allowed error at a
+        // distance of 1: pixels per world unit at that distance divided by the allowed pixels.
+        void select(int faceIndex, const Mat4<float>& transform, const Vec3f& cameraPosition, float errorScale,
+            std::vector<DrawRange>& ranges);
+
+    private:
+        struct QuadPatch {
+            Vec3f center;
+            float radius;
+            float curvature;    // Largest second difference of the control rows, plus that of the columns, plus the twist
+        };
+
+        struct PatchFace {
+            int firstQuadPatch = 0;
+            int width = 0;          // Quadratic patches per row, 0 for faces that are not patches
+            int height = 0;
+            int firstVertex = 0;    // In the patch vertex buffer
+        };
+
+        int tessellationLevel = 0;
+        std::vector<int> levels;
+        std::vector<PatchFace> patchFaces;      // Indexed by face
+        std::vector<QuadPatch> quadPatches;
+
+        std::vector<GLuint> indices;
+        std::vector<DrawRange> combinations;    // Into indices, indexed by combination()
+        std::vector<int> chosen;                // Levels of the face being selected
+
+        int combination(int level, const int edges[4]) const;
+        void buildCombination(int level, const int edges[4]);
+    };
+}
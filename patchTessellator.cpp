@@ -0,0 +1,208 @@
+#include <algorithm>
+#include <cmath>
+
+#include "patchTessellator.h"
+#include "simd.h"
+
+namespace BSP {
+    // The attributes of a vertex as floats, one row of the evaluation each
+    enum PatchAttribute {
+        ATTRIBUTE_POSITION = 0,     // x, y, z
+        ATTRIBUTE_TEXTURE = 3,      // u, v
+        ATTRIBUTE_LIGHTMAP = 5,     // u, v
+        ATTRIBUTE_NORMAL = 7,       // x, y, z
+        ATTRIBUTE_COLOR = 10,       // r, g, b, a in [0, 255]
+        ATTRIBUTE_COUNT = 14
+    };
+
+    // Floats per attribute row, MAX_LEVEL + 1 vertices rounded up to a multiple of 4
+    static const int ROW_SIZE = (PatchTessellator::MAX_LEVEL + 4) & ~3;
+
+    PatchTessellator::PatchTessellator(int level)
+        : level(std::min(std::max(level, 1), MAX_LEVEL)) {
+        int padded = (this->level + 4) & ~3;
+        for (std::vector<float>& weight : weights)
+            weight.assign(padded, 0.0f);
+
+        for (int step = 0; step <= this->level; step++) {
+            float t = static_cast<float>(step) / this->level;
+            weights[0][step] = (1.0f - t) * (1.0f - t);
+            weights[1][step] = (1.0f - t) * t * 2;
+            weights[2][step] = t * t;
+        }
+    }
+
+    static void gather(const Vertex& vertex, float attributes[ATTRIBUTE_COUNT]) {
+        Vec3f position = vertex.getPosition();
+        Vec2f textureCoord = vertex.getTextureCoord();
+        Vec2f lightmapCoord = vertex.getLightmapCoord();
+        Vec3f normal = vertex.getNormal();
+
+        for (int i = 0; i < 3; i++) {
+            attributes[ATTRIBUTE_POSITION + i] = position[i];
+            attributes[ATTRIBUTE_NORMAL + i] = normal[i];
+        }
+        for (int i = 0; i < 2; i++) {
+            attributes[ATTRIBUTE_TEXTURE + i] = textureCoord[i];
+            attributes[ATTRIBUTE_LIGHTMAP + i] = lightmapCoord[i];
+        }
+        for (int i = 0; i < 4; i++)
+            attributes[ATTRIBUTE_COLOR + i] = static_cast<float>(vertex.getColor()[i]);
+    }
+
+    // Calls sink(i, rows) for every grid row i, with the attributes of its vertices in rows[attribute * ROW_SIZE + j].
+    // Normals come out normalized and colors rounded to whole values in [0, 255].
+    template <typename Sink>
+    void PatchTessellator::evaluate(const Vertex* const controlPoints[9], Sink sink) const {
+        float points[9][ATTRIBUTE_COUNT];
+        for (int i = 0; i < 9; i++)
+            gather(*controlPoints[i], points[i]);
+
+        alignas(16) float rows[ATTRIBUTE_COUNT * ROW_SIZE];
+        const int count = level + 1;
+
+        for (int i = 0; i <= level; i++) {
+            // The three control rows blended across their columns, then every vertex of the grid row
+            // blends those, (p0 * b0 + p1 * b1) + p2 * b2 in both steps
+            float across[3][ATTRIBUTE_COUNT];
+            for (int r = 0; r < 3; r++) {
+                for (int a = 0; a < ATTRIBUTE_COUNT; a++) {
+                    across[r][a] = points[r * 3][a] * weights[0][i] + points[r * 3 + 1][a] * weights[1][i] +
+                        points[r * 3 + 2][a] * weights[2][i];
+                }
+            }
+
+            float* normals = rows + ATTRIBUTE_NORMAL * ROW_SIZE;
+            float* colors = rows + ATTRIBUTE_COLOR * ROW_SIZE;
+
+#if BSP_SIMD_SSE2
+            for (int a = 0; a < ATTRIBUTE_COUNT; a++) {
+                const __m128 p0 = _mm_set1_ps(across[0][a]);
+                const __m128 p1 = _mm_set1_ps(across[1][a]);
+                const __m128 p2 = _mm_set1_ps(across[2][a]);
+                float* row = rows + a * ROW_SIZE;
+
+                for (int j = 0; j < count; j += 4) {
+                    __m128 value = _mm_add_ps(
+                        _mm_add_ps(_mm_mul_ps(p0, _mm_loadu_ps(&weights[0][j])), _mm_mul_ps(p1, _mm_loadu_ps(&weights[1][j]))),
+                        _mm_mul_ps(p2, _mm_loadu_ps(&weights[2][j])));
+                    _mm_store_ps(row + j, value);
+                }
+            }
+
+            const __m128 zero = _mm_setzero_ps();
+            const __m128 one = _mm_set1_ps(1.0f);
+            const __m128 half = _mm_set1_ps(0.5f);
+            const __m128 largest = _mm_set1_ps(255.0f);
+
+            for (int j = 0; j < count; j += 4) {
+                // Blended unit normals are shorter than 1
+                __m128 x = _mm_load_ps(normals + j);
+                __m128 y = _mm_load_ps(normals + ROW_SIZE + j);
+                __m128 z = _mm_load_ps(normals + 2 * ROW_SIZE + j);
+                __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)));
+                __m128 positive = _mm_cmpgt_ps(length, zero);
+                __m128 inverse = _mm_div_ps(one, length);
+
+                _mm_store_ps(normals + j, _mm_or_ps(_mm_and_ps(positive, _mm_mul_ps(x, inverse)), _mm_andnot_ps(positive, x)));
+                _mm_store_ps(normals + ROW_SIZE + j, _mm_or_ps(_mm_and_ps(positive, _mm_mul_ps(y, inverse)), _mm_andnot_ps(positive, y)));
+                _mm_store_ps(normals + 2 * ROW_SIZE + j, _mm_or_ps(_mm_and_ps(positive, _mm_mul_ps(z, inverse)), _mm_andnot_ps(positive, z)));
+
+                for (int c = 0; c < 4; c++) {
+                    __m128 color = _mm_min_ps(_mm_max_ps(_mm_load_ps(colors + c * ROW_SIZE + j), zero), largest);
+                    _mm_store_ps(colors + c * ROW_SIZE + j, _mm_cvtepi32_ps(_mm_cvttps_epi32(_mm_add_ps(color, half))));
+                }
+            }
+#else
+            for (int a = 0; a < ATTRIBUTE_COUNT; a++) {
+                float* row = rows + a * ROW_SIZE;
+                for (int j = 0; j < count; j++)
+                    row[j] = across[0][a] * weights[0][j] + across[1][a] * weights[1][j] + across[2][a] * weights[2][j];
+            }
+
+            for (int j = 0; j < count; j++) {
+                float& x = normals[j];
+                float& y = normals[ROW_SIZE + j];
+                float& z = normals[2 * ROW_SIZE + j];
+                float length = std::sqrt(x * x + y * y + z * z);
+                if (length > 0.0f) {
+                    float inverse = 1.0f / length;
+                    x *= inverse;
+                    y *= inverse;
+                    z *= inverse;
+                }
+
+                for (int c = 0; c < 4; c++) {
+                    float color = std::min(255.0f, std::max(0.0f, colors[c * ROW_SIZE + j]));
+                    colors[c * ROW_SIZE + j] = static_cast<float>(static_cast<int>(color + 0.5f));
+                }
+            }
+#endif
+
+            sink(i, rows);
+        }
+    }
+
+    void PatchTessellator::tessellate(const Vertex* const controlPoints[9], const VertexFormat& format, unsigned char* out) const {
+        const int count = level + 1;
+        const size_t stride = format.stride();
+
+        evaluate(controlPoints, [&](int i, const float* rows) {
+            unsigned char* destination = out + static_cast<size_t>(i) * count * stride;
+
+            for (int j = 0; j < count; j++) {
+                float position[3], textureCoord[2], lightmapCoord[2], normal[3];
+                unsigned char color[4];
+
+                for (int k = 0; k < 3; k++) {
+                    position[k] = rows[(ATTRIBUTE_POSITION + k) * ROW_SIZE + j];
+                    normal[k] = rows[(ATTRIBUTE_NORMAL + k) * ROW_SIZE + j];
+                }
+                for (int k = 0; k < 2; k++) {
+                    textureCoord[k] = rows[(ATTRIBUTE_TEXTURE + k) * ROW_SIZE + j];
+                    lightmapCoord[k] = rows[(ATTRIBUTE_LIGHTMAP + k) * ROW_SIZE + j];
+                }
+                for (int k = 0; k < 4; k++)
+                    color[k] = static_cast<unsigned char>(rows[(ATTRIBUTE_COLOR + k) * ROW_SIZE + j]);
+
+                format.write(position, color, textureCoord, lightmapCoord, normal, destination);
+                destination += stride;
+            }
+        });
+    }
+
+    void PatchTessellator::tessellate(const Vertex* const controlPoints[9], Vertex* out) const {
+        const int count = level + 1;
+
+        evaluate(controlPoints, [&](int i, const float* rows) {
+            auto at = [rows](int attribute, int j) { return rows[attribute * ROW_SIZE + j]; };
+
+            for (int j = 0; j < count; j++) {
+                Vertex& vertex = out[i * count + j];
+                vertex.setPosition(Vec3f(at(ATTRIBUTE_POSITION, j), at(ATTRIBUTE_POSITION + 1, j), at(ATTRIBUTE_POSITION + 2, j)));
+                vertex.setTextureCoord(Vec2f(at(ATTRIBUTE_TEXTURE, j), at(ATTRIBUTE_TEXTURE + 1, j)));
+                vertex.setLightmapCoord(Vec2f(at(ATTRIBUTE_LIGHTMAP, j), at(ATTRIBUTE_LIGHTMAP + 1, j)));
+                vertex.setNormal(Vec3f(at(ATTRIBUTE_NORMAL, j), at(ATTRIBUTE_NORMAL + 1, j), at(ATTRIBUTE_NORMAL + 2, j)));
+                vertex.setColor(Vec4f(at(ATTRIBUTE_COLOR, j), at(ATTRIBUTE_COLOR + 1, j), at(ATTRIBUTE_COLOR + 2, j), at(ATTRIBUTE_COLOR + 3, j)));
+            }
+        });
+    }
+
+    void PatchTessellator::writeIndices(GLuint baseVertex, GLuint* out) const {
+        const GLuint count = static_cast<GLuint>(level + 1);
+
+        for (GLuint row = 0; row < static_cast<GLuint>(level); row++) {
+            for (GLuint column = 0; column < static_cast<GLuint>(level); column++) {
+                GLuint corner = baseVertex + row * count + column;
+
+                *out++ = corner;
+                *out++ = corner + count;
+                *out++ = corner + count + 1;
+
+                *out++ = corner;
+                *out++ = corner + count + 1;
+                *out++ = corner + 1;
+            }
+        }
+    }
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <vector>
+
+#include "GL_Utils.h"
+#include "vertices.h"
+#include "vertexFormat.h"
+
+namespace BSP {
+    /*
+    Tessellation of one 3x3 quadratic Bezier patch into a grid of (level + 1) x (level + 1) vertices,
+    the kernel behind QuadraticPatch::tesselate() and the patch buffers of the loader.
+
+    The Bernstein weights of every step are computed once per level. Each row of the grid is evaluated
+    for every attribute in structure-of-arrays form, four vertices at a time with SSE2, and encoded
+    right into the destination. Nothing is allocated per patch and tessellate() is const, so threads
+    can share one tessellator. The scalar path gives the same vertices, bit for bit, as the SIMD one.
+    */
+    class PatchTessellator {
+    public:
+        static const int MAX_LEVEL = 64;
+
+        explicit PatchTessellator(int level);     // Clamped to [1, MAX_LEVEL]
+
+        int getLevel() const { return level; }
+        int getVertexCount() const { return (level + 1) * (level + 1); }
+        int getIndexCount() const { return level * level * 6; }
+
+        // Vertex (i, j) of the grid goes to i * (level + 1) + j, i along the control columns and j along
+        // the control rows. controlPoints are row by row, like the patch vertices of a face.
+        void tessellate(const Vertex* const controlPoints[9], const VertexFormat& format, unsigned char* out) const;
+        void tessellate(const Vertex* const controlPoints[9], Vertex* out) const;
+
+        // Two triangles per grid cell, baseVertex is added to every index
+        void writeIndices(GLuint baseVertex, GLuint* out) const;
+
+    private:
+        int level;
+        std::vector<float> weights[3];  // Quadratic Bernstein weights of each step, padded to a multiple of 4
+
+        template <typename Sink>
+        void evaluate(const Vertex* const controlPoints[9], Sink sink) const;
+    };
+}
@@ -6,6 +6,9 @@ PerspectiveCamera::PerspectiveCamera(float fov, float aspectRatio, float near, f
 }
 
 void PerspectiveCamera::updateViewMatrix() {
+    if (!viewDirty)
+        return;
+
     // Assuming the right vector is derived from forward and up
     right = forward.cross(up).normalize();
 
@@ -16,6 +19,9 @@ void PerspectiveCamera::updateViewMatrix() {
         forward.x(), forward.y(), forward.z(), forward.dot(position),
         0.0f, 0.0f, 0.0f, 1.0f
     };
+
+    viewDirty = false;
+    revision++;
 }
 
 Mat4<float> PerspectiveCamera::getViewMatrix() const {
@@ -23,6 +29,9 @@ Mat4<float> PerspectiveCamera::getViewMatrix() const {
 }
 
 void PerspectiveCamera::updateProjectionMatrix() {
+    if (!projectionDirty)
+        return;
+
     // Compute the projection matrix based on fov, aspect ratio, near and far clipping planes
     float fovRadians = fov * 3.14159265359f / 180.0f; // Convert fov from degrees to radians
     float tanHalfFov = std::tan(fovRadians / 2.0f);
@@ -34,6 +43,9 @@ void PerspectiveCamera::updateProjectionMatrix() {
         0.0f, 0.0f, (far + near) / range, 2.0f * near * far / range,
         0.0f, 0.0f, -1.0f, 0.0f
     };
+
+    projectionDirty = false;
+    revision++;
 }
 
 Mat4<float> PerspectiveCamera::getProjectionMatrix() const {
@@ -42,5 +54,6 @@ Mat4<float> PerspectiveCamera::getProjectionMatrix() const {
 
 void PerspectiveCamera::setFov(float newFov) {
     fov = newFov;
+    projectionDirty = true;
     updateProjectionMatrix();
 }
@@ -7,6 +7,7 @@ class PerspectiveCamera : public Camera {
 public:
     PerspectiveCamera(float fov, float aspectRatio, float near, float far);
 
+    // Both only recompute their matrix when something it depends on changed
     void updateViewMatrix() override;
     Mat4<float> getViewMatrix() const override;
 
@@ -22,4 +23,5 @@ private:
     float far;
     Mat4<float> viewMatrix;
     Mat4<float> projectionMatrix;
+    bool projectionDirty = true;
 };
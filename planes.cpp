@@ -1,25 +1,13 @@
 #include "planes.h"
+#include "transcode.h"
 #include "utils.h"
 
 namespace BSP {
-    void Planes::load(std::ifstream& file, LumpData& lumpData) {
-        Element::load(file, lumpData);
-        updateYAndZ();
-    }
-
-    // Swap the y and z values, and negate the new z so Y is up 
-    // the swapping of y and z values and negating the new z value is related 
-    // to the differences in coordinate systems used in the Quake 3 engine and 
-    // most 3D modeling software
-    void Planes::updateYAndZ() {
-        for (auto& plane : elements) {
-            Vec3<float> normal = plane.getNormal();
-
-            normal.y() = plane.getNormal().z();
-            normal.z() = -plane.getNormal().y();
-
-            plane.setNormal(normal);
-        }
+    // The distance is unchanged by the rotation, and it is what the wide helper spills into
+    void Planes::transcode(const Plane* source, Plane* destination, size_t count) {
+        Transcode::records(source, destination, count, [](Plane& plane, bool) {
+            Transcode::vectorWide(&plane.normal[0]);
+        });
     }
 
     void Planes::validate() {
@@ -24,15 +24,19 @@ namespace BSP {
         ~Plane() = default;
 
     private:
+        friend class Planes;
+
         Vec3f normal;          // Plane normal.
         float distanceFromOrigin;    // The plane distance from origin
     };
 
     class Planes : public BSP::Element<Plane> {
     public:
-        void load(std::ifstream& file, LumpData& lumpData) override;
-        void updateYAndZ();
         void validate() override;
         void displayData() const override;
+
+    protected:
+        bool isTranscoded() const override { return true; }
+        void transcode(const Plane* source, Plane* destination, size_t count) override;
     };
 }
@@ -4,6 +4,8 @@
 
 namespace BSP {
     void PotentiallyVisibleSet::load(std::ifstream& file, LumpData& lumpData) {
+        mappedBitsets = LumpView<char>();
+
         if (lumpData.length == 0) {
             // No visibility data, set to default values
             numOfClusters = 0;
@@ -25,6 +27,27 @@ namespace BSP {
         validate();
     }
 
+    void PotentiallyVisibleSet::load(const MappedFile& file, LumpData& lumpData) {
+        bitsets.clear();
+        mappedBitsets = LumpView<char>();
+
+        if (lumpData.length < static_cast<int>(2 * sizeof(int)) || !file.contains(lumpData)) {
+            // No visibility data, set to default values
+            numOfClusters = 0;
+            charsPerCluster = 0;
+            return;
+        }
+
+        const char* lump = file.data() + lumpData.offset;
+        std::memcpy(&numOfClusters, lump, sizeof(int));
+        std::memcpy(&charsPerCluster, lump + sizeof(int), sizeof(int));
+
+        LumpData bitsetData{ lumpData.offset + static_cast<int>(2 * sizeof(int)), numOfClusters * charsPerCluster };
+        mappedBitsets = file.view<char>(bitsetData);
+
+        validate();
+    }
+
     void PotentiallyVisibleSet::validate() {
         // Check if the number of clusters is positive
         warning_assert(numOfClusters > 0, "Invalid number of clusters in PVS data.");
@@ -33,7 +56,7 @@ namespace BSP {
         warning_assert(charsPerCluster > 0, "Invalid number of chars per cluster in PVS data.");
 
         // Check if the size of the bitsets vector matches the expected size
-        warning_assert(static_cast<int>(bitsets.size()) == numOfClusters * charsPerCluster,
+        warning_assert(static_cast<int>(getBitsets().size()) == numOfClusters * charsPerCluster,
             "Invalid size of bitsets vector.");
     }
 
@@ -46,11 +69,12 @@ namespace BSP {
 
         // Display the bitsets data
         std::cout << "Bitsets:" << std::endl;
+        LumpView<char> clusterBitsets = getBitsets();
         int index = 0;
         for (int i = 0; i < numOfClusters; ++i) {
             std::cout << "Cluster " << i << ": ";
             for (int j = 0; j < charsPerCluster; ++j) {
-                std::cout << static_cast<int>(bitsets[index++]) << " ";
+                std::cout << static_cast<int>(clusterBitsets[index++]) << " ";
             }
             std::cout << std::endl;
         }
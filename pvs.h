@@ -38,11 +38,19 @@ namespace BSP {
         // Accessor (getter) methods
         int getNumOfClusters() const { return numOfClusters; }
         int getCharsPerCluster() const { return charsPerCluster; }
-        const std::vector<char>& getBitsets() const { return bitsets; }
+        LumpView<char> getBitsets() const {
+            if (mappedBitsets.data() != nullptr) {
+                return mappedBitsets;
+            }
+            return LumpView<char>(bitsets.data(), bitsets.size());
+        }
 
         // Read PVS data from file
         void load(std::ifstream& file, LumpData& lumpData);
 
+        // Read PVS data from a mapped file, the bitsets are viewed in place
+        void load(const MappedFile& file, LumpData& lumpData);
+
         // Validate PVS data
         void validate();
 
@@ -53,5 +61,6 @@ namespace BSP {
         int numOfClusters;                     // The number of clusters
         int charsPerCluster;                   // The amount of chars (8 bits) in the cluster's bitset
         std::vector<char> bitsets;             // The vector of chars that holds the cluster bitsets
+        LumpView<char> mappedBitsets;          // The cluster bitsets inside a MappedFile (zero-copy load)
     };
 }
@@ -0,0 +1,83 @@
+#include "renderBackend.h"
+#include "glStateCache.h"
+
+namespace BSP {
+    const uint64_t RenderBackend::BUCKET_MASK =
+        (0x3FFFFULL << SortKey::STREAM_SHIFT);
+
+    void RenderBackend::setProgram(int index, GLuint program) {
+        if (index >= static_cast<int>(programs.size())) {
+            programs.resize(index + 1, 0);
+        }
+        programs[index] = program;
+    }
+
+    void RenderBackend::setStreamVAO(int stream, GLuint vao) {
+        if (stream >= static_cast<int>(streamVAOs.size())) {
+            streamVAOs.resize(stream + 1, 0);
+        }
+        streamVAOs[stream] = vao;
+    }
+
+    int RenderBackend::flush() {
+        int drawCalls = batch.submit();
+        batch.clear();
+        return drawCalls;
+    }
+
+    int RenderBackend::execute(const RenderQueue& queue) {
+        GLStateCache& state = GLStateCache::shared();
+        int drawCalls = 0;
+        int program = -1;
+        int transform = -1;
+        int stream = -1;
+        GLint modelLocation = -1;
+        bool transformChanged = false;
+
+        batch.clear();
+
+        for (size_t i = 0; i < queue.size(); i++) {
+            uint64_t key = queue.getKey(i);
+
+            if (i == 0 || ((key ^ queue.getKey(i - 1)) & BUCKET_MASK) != 0) {
+                drawCalls += flush();
+
+                if (SortKey::program(key) != program) {
+                    program = SortKey::program(key);
+                    GLuint glProgram = program < static_cast<int>(programs.size()) ? programs[program] : 0;
+                    state.useProgram(glProgram);
+                    modelLocation = state.getUniformLocation(glProgram, "model");
+                    transform = -1;
+                }
+
+                if (SortKey::transform(key) != transform) {
+                    transform = SortKey::transform(key);
+
+                    // The shader expects column-major matrices, like in renderFrame
+                    glUniformMatrix4fv(modelLocation, 1, GL_FALSE, queue.getTransform(transform).transpose().getData());
+                    transformChanged = true;
+                }
+
+                if (SortKey::stream(key) != stream) {
+                    stream = SortKey::stream(key);
+                    state.bindVertexArray(stream < static_cast<int>(streamVAOs.size()) ? streamVAOs[stream] : 0);
+                }
+            }
+
+            batch.add(queue.getRange(i));
+            if (!batching) {
+                drawCalls += flush();
+            }
+        }
+
+        drawCalls += flush();
+
+        // Back to the identity the rest of the frame is drawn with
+        if (transformChanged) {
+            glUniformMatrix4fv(modelLocation, 1, GL_FALSE, Mat4<float>().getData());
+        }
+        state.bindVertexArray(0);
+
+        return drawCalls;
+    }
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <vector>
+
+#include "GL_Utils.h"
+#include "renderQueue.h"
+#include "drawBatch.h"
+
+namespace BSP {
+    /*
+    Thin GL consumer of a sorted RenderQueue. Consecutive draws whose keys match in the bucket fields
+    (program, transform and stream, the state this backend binds) are submitted as one DrawBatch.
+    Texture and lightmap are part of the sort order but do not split batches until they are bound.
+    */
+    class RenderBackend {
+    public:
+        // GL objects the key fields refer to
+        void setProgram(int index, GLuint program);
+        void setStreamVAO(int stream, GLuint vao);
+
+        // One multi-draw per bucket (default) or one draw per queued range
+        void setBatching(bool value) { batching = value; }
+
+        // Draws the queue in its current order, returns the number of GL draw calls made.
+        // The "model" uniform is back to identity and no VAO is bound afterwards.
+        int execute(const RenderQueue& queue);
+
+    private:
+        static const uint64_t BUCKET_MASK;
+
+        std::vector<GLuint> programs;
+        std::vector<GLuint> streamVAOs;
+        bool batching = true;
+        DrawBatch batch;
+
+        int flush();
+    };
+}
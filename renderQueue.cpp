@@ -0,0 +1,96 @@
+#include <algorithm>
+#include <cassert>
+
+#include "renderQueue.h"
+
+namespace BSP {
+    uint64_t SortKey::make(int program, int transform, int texture, int lightmap, int stream, uint32_t depth) {
+        return (static_cast<uint64_t>(program & 0x3F) << PROGRAM_SHIFT)
+            | (static_cast<uint64_t>(transform & 0x3FF) << TRANSFORM_SHIFT)
+            | (static_cast<uint64_t>(texture & 0xFFF) << TEXTURE_SHIFT)
+            | (static_cast<uint64_t>(lightmap & 0x3FF) << LIGHTMAP_SHIFT)
+            | (static_cast<uint64_t>(stream & 0x3) << STREAM_SHIFT)
+            | (depth & ((1u << DEPTH_BITS) - 1));
+    }
+
+    uint32_t SortKey::quantizeDepth(float distance, float maxDistance) {
+        const uint32_t maxDepth = (1u << DEPTH_BITS) - 1;
+
+        if (!(distance > 0.0f) || !(maxDistance > 0.0f)) {
+            return 0;
+        }
+        if (distance >= maxDistance) {
+            return maxDepth;
+        }
+
+        return static_cast<uint32_t>(distance / maxDistance * maxDepth);
+    }
+
+    void RenderQueue::clear() {
+        entries.clear();
+        ranges.clear();
+        transforms.clear();
+    }
+
+    int RenderQueue::addTransform(const Mat4<float>& transform) {
+        assert(transforms.size() < static_cast<size_t>(SortKey::MAX_TRANSFORMS));
+        if (transforms.size() >= static_cast<size_t>(SortKey::MAX_TRANSFORMS)) {
+            return -1;
+        }
+
+        transforms.push_back(transform);
+        return static_cast<int>(transforms.size()) - 1;
+    }
+
+    void RenderQueue::push(uint64_t key, const DrawRange& range) {
+        entries.push_back(Entry{ key, static_cast<uint32_t>(ranges.size()) });
+        ranges.push_back(range);
+    }
+
+    void RenderQueue::sort() {
+        const size_t count = entries.size();
+        if (count < 2) {
+            return;
+        }
+
+        // Histograms of all 8 digits in a single pass over the keys
+        size_t histograms[8][256] = {};
+        for (const Entry& entry : entries) {
+            for (int pass = 0; pass < 8; pass++) {
+                histograms[pass][(entry.key >> (pass * 8)) & 0xFF]++;
+            }
+        }
+
+        scratch.resize(count);
+        Entry* source = entries.data();
+        Entry* destination = scratch.data();
+
+        for (int pass = 0; pass < 8; pass++) {
+            size_t* histogram = histograms[pass];
+            int shift = pass * 8;
+
+            // Every key has the same digit, this pass would not move anything
+            if (histogram[(source[0].key >> shift) & 0xFF] == count) {
+                continue;
+            }
+
+            size_t offset = 0;
+            for (int digit = 0; digit < 256; digit++) {
+                size_t digitCount = histogram[digit];
+                histogram[digit] = offset;
+                offset += digitCount;
+            }
+
+            for (size_t i = 0; i < count; i++) {
+                destination[histogram[(source[i].key >> shift) & 0xFF]++] = source[i];
+            }
+
+            std::swap(source, destination);
+        }
+
+        // An odd number of passes leaves the result in the scratch buffer
+        if (source != entries.data()) {
+            entries.swap(scratch);
+        }
+    }
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "drawRange.h"
+#include "matrix.h"
+
+namespace BSP {
+    // Geometry streams of the map, each one is a VAO with its own element buffer
+    enum DrawStream {
+        STREAM_FACES = 0,   // Polygons and meshes
+        STREAM_PATCHES = 1, // Tessellated patches
+        STREAM_PATCH_LOD = 2    // Tessellated patches at a level chosen per frame, see PatchLod
+    };
+
+    /*
+    64-bit sort key of a queued draw. From the most to the least significant bits:
+
+    program     6 bits      index of the shader program
+    transform  10 bits      index of the model matrix in the queue
+    stream      2 bits      DrawStream, selects the VAO
+    texture    12 bits      texture of the face
+    lightmap   10 bits      lightmap of the face + 1 (0 when the face has none)
+    depth      24 bits      quantized distance to the camera, near first
+
+    Sorting the keys groups the draws by the state that is the most expensive to change, and within
+    the same state orders them front to back. The stream sits above the textures because the VAO is
+    bound for every bucket while textures are not bound yet. Values wider than their field are wrapped.
+    */
+    struct SortKey {
+        static const int PROGRAM_SHIFT = 58;
+        static const int TRANSFORM_SHIFT = 48;
+        static const int STREAM_SHIFT = 46;
+        static const int TEXTURE_SHIFT = 34;
+        static const int LIGHTMAP_SHIFT = 24;
+        static const int DEPTH_BITS = 24;
+        static const int MAX_TRANSFORMS = 1 << 10;
+
+        static uint64_t make(int program, int transform, int texture, int lightmap, int stream, uint32_t depth);
+
+        static int program(uint64_t key) { return static_cast<int>(key >> PROGRAM_SHIFT) & 0x3F; }
+        static int transform(uint64_t key) { return static_cast<int>(key >> TRANSFORM_SHIFT) & 0x3FF; }
+        static int texture(uint64_t key) { return static_cast<int>(key >> TEXTURE_SHIFT) & 0xFFF; }
+        static int lightmap(uint64_t key) { return static_cast<int>(key >> LIGHTMAP_SHIFT) & 0x3FF; }
+        static int stream(uint64_t key) { return static_cast<int>(key >> STREAM_SHIFT) & 0x3; }
+        static uint32_t depth(uint64_t key) { return static_cast<uint32_t>(key) & ((1u << DEPTH_BITS) - 1); }
+
+        // distance / maxDistance mapped to the depth field, clamped to [0, 1]
+        static uint32_t quantizeDepth(float distance, float maxDistance);
+    };
+
+    /*
+    Per-frame list of visible surfaces. Culling emits a key and a draw range for each surface, sort()
+    orders them once, and a backend (RenderBackend for GL) consumes them in key order.
+
+    The queue never calls GL, so it can be filled, sorted and measured without a context. The arrays
+    are kept between frames.
+    */
+    class RenderQueue {
+    public:
+        void clear();
+
+        // Model matrix used by the draws that carry the returned index in their key. -1 once the queue
+        // holds SortKey::MAX_TRANSFORMS of them, the index would not fit in the key.
+        int addTransform(const Mat4<float>& transform);
+        const Mat4<float>& getTransform(int index) const { return transforms[index]; }
+
+        void push(uint64_t key, const DrawRange& range);
+
+        // Stable LSD radix sort of the keys, 8 bits per pass. Passes where every key has the same
+        // digit are skipped, so keys that only differ in a few fields sort in a few passes.
+        void sort();
+
+        size_t size() const { return entries.size(); }
+        bool empty() const { return entries.empty(); }
+
+        // In sorted order once sort() was called, in push order before
+        uint64_t getKey(size_t index) const { return entries[index].key; }
+        const DrawRange& getRange(size_t index) const { return ranges[entries[index].item]; }
+
+    private:
+        struct Entry {
+            uint64_t key;
+            uint32_t item;  // Index into ranges
+        };
+
+        std::vector<Entry> entries;
+        std::vector<Entry> scratch;     // Second buffer of the radix sort
+        std::vector<DrawRange> ranges;
+        std::vector<Mat4<float>> transforms;
+    };
+}
@@ -0,0 +1,135 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "renderQueueCheck.h"
+#include "renderQueue.h"
+
+namespace BSP {
+    // Fixed, so a failure shows up the same way on every run
+    static const unsigned int SEED = 1234;
+
+    static bool checkFields(int program, int transform, int texture, int lightmap, int stream, uint32_t depth) {
+        uint64_t key = SortKey::make(program, transform, texture, lightmap, stream, depth);
+        if (SortKey::program(key) == program && SortKey::transform(key) == transform && SortKey::texture(key) == texture &&
+            SortKey::lightmap(key) == lightmap && SortKey::stream(key) == stream && SortKey::depth(key) == depth)
+            return true;
+
+        std::cout << "render queue: key of program " << program << " transform " << transform << " texture " << texture
+            << " lightmap " << lightmap << " stream " << stream << " depth " << depth << " does not read back" << std::endl;
+        return false;
+    }
+
+    // Sorts the keys in a queue and compares the order with std::stable_sort, the ranges carry the push order
+    static bool checkSort(const char* name, const std::vector<uint64_t>& keys) {
+        RenderQueue queue;
+        for (size_t i = 0; i < keys.size(); i++)
+            queue.push(keys[i], DrawRange{ static_cast<int>(i), 0, 0 });
+        queue.sort();
+
+        std::vector<size_t> expected(keys.size());
+        for (size_t i = 0; i < expected.size(); i++)
+            expected[i] = i;
+        std::stable_sort(expected.begin(), expected.end(), [&keys](size_t a, size_t b) { return keys[a] < keys[b]; });
+
+        if (queue.size() != keys.size()) {
+            std::cout << "render queue: " << name << " sort has " << queue.size() << " draws instead of " << keys.size() << std::endl;
+            return false;
+        }
+        for (size_t i = 0; i < expected.size(); i++) {
+            if (queue.getKey(i) != keys[expected[i]] || queue.getRange(i).first != static_cast<int>(expected[i])) {
+                std::cout << "render queue: " << name << " sort differs from std::stable_sort at draw " << i << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool checkRenderQueue() {
+        bool ok = true;
+
+        // Every field at zero, at its largest value and in between
+        ok &= checkFields(0, 0, 0, 0, 0, 0);
+        ok &= checkFields(0x3F, SortKey::MAX_TRANSFORMS - 1, 0xFFF, 0x3FF, STREAM_PATCH_LOD, (1u << SortKey::DEPTH_BITS) - 1);
+        ok &= checkFields(5, 17, 300, 42, STREAM_PATCHES, 123456);
+
+        // A field outranks all the fields below it put together
+        uint64_t lowerFields = SortKey::make(0, SortKey::MAX_TRANSFORMS - 1, 0xFFF, 0x3FF, 3, (1u << SortKey::DEPTH_BITS) - 1);
+        if (!(SortKey::make(1, 0, 0, 0, 0, 0) > lowerFields)) {
+            std::cout << "render queue: the program does not outrank the other fields" << std::endl;
+            ok = false;
+        }
+
+        if (SortKey::quantizeDepth(-1.0f, 100.0f) != 0 || SortKey::quantizeDepth(200.0f, 100.0f) != (1u << SortKey::DEPTH_BITS) - 1 ||
+            !(SortKey::quantizeDepth(10.0f, 100.0f) < SortKey::quantizeDepth(20.0f, 100.0f))) {
+            std::cout << "render queue: depth is not clamped or not increasing" << std::endl;
+            ok = false;
+        }
+
+        RenderQueue transforms;
+        int lastTransform = -1;
+        for (int i = 0; i < SortKey::MAX_TRANSFORMS; i++)
+            lastTransform = transforms.addTransform(Mat4<float>());
+        if (lastTransform != SortKey::MAX_TRANSFORMS - 1) {
+            std::cout << "render queue: transform " << lastTransform << " returned for the last one that fits" << std::endl;
+            ok = false;
+        }
+
+        std::mt19937 random(SEED);
+        std::vector<uint64_t> keys(5000);
+
+        // Every byte differs, all 8 passes run
+        for (uint64_t& key : keys)
+            key = (static_cast<uint64_t>(random()) << 32) | random();
+        ok &= checkSort("random", keys);
+
+        // Only depth and texture vary, most passes are skipped. Few values, so many keys are equal.
+        for (uint64_t& key : keys)
+            key = SortKey::make(0, 0, random() % 4, 0, STREAM_FACES, random() % 16);
+        ok &= checkSort("sparse", keys);
+
+        // A single pass, the result is left in the second buffer
+        for (uint64_t& key : keys)
+            key = random() % 256;
+        ok &= checkSort("odd", keys);
+
+        ok &= checkSort("empty", std::vector<uint64_t>());
+        ok &= checkSort("single", std::vector<uint64_t>(1, 7));
+
+        std::cout << "render queue checks " << (ok ? "passed" : "FAILED") << std::endl;
+        return ok;
+    }
+
+    void benchmarkRenderQueue(size_t drawCount, int frames) {
+        std::mt19937 random(SEED);
+        std::vector<uint64_t> keys(drawCount);
+        for (uint64_t& key : keys) {
+            key = SortKey::make(0, random() % 8, random() % 64, random() % 32, random() % 3,
+                random() & ((1u << SortKey::DEPTH_BITS) - 1));
+        }
+
+        RenderQueue queue;
+        double fillTime = 0.0;
+        double sortTime = 0.0;
+
+        for (int frame = 0; frame < frames; frame++) {
+            auto start = std::chrono::steady_clock::now();
+            queue.clear();
+            for (size_t i = 0; i < keys.size(); i++)
+                queue.push(keys[i], DrawRange{ static_cast<int>(i), 0, 0 });
+            auto filled = std::chrono::steady_clock::now();
+            queue.sort();
+            auto sorted = std::chrono::steady_clock::now();
+
+            fillTime += std::chrono::duration<double, std::milli>(filled - start).count();
+            sortTime += std::chrono::duration<double, std::milli>(sorted - filled).count();
+        }
+
+        if (frames > 0) {
+            std::cout << "render queue: " << drawCount << " draws, fill " << fillTime / frames << " ms, sort "
+                << sortTime / frames << " ms per frame" << std::endl;
+        }
+    }
+}
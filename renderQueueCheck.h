@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstddef>
+
+namespace BSP {
+    // Checks of the sort key packing and of RenderQueue::sort() against std::stable_sort. Nothing
+    // here calls GL, main() runs them without a window when started with --check-render-queue.
+    // Prints every failure, returns false if there was one.
+    bool checkRenderQueue();
+
+    // Fills and sorts a queue of drawCount draws with keys like the ones of a map, frames times,
+    // and prints the mean time of both per frame
+    void benchmarkRenderQueue(size_t drawCount, int frames);
+}
@@ -1,19 +1,20 @@
 #pragma once
 
 #include "GL_Utils.h"
+#include "cameraUniforms.h"
 
 GLuint initShader() {
     // Vertex shader source code
+    // View and projection come from the shared camera uniform block
     const char* vertexShaderSource = "#version 330 core\n"
+        CAMERA_UNIFORM_BLOCK
         "layout (location = 0) in vec3 aPos;\n"
         "layout (location = 1) in vec3 aColor;\n"
         "out vec3 color;\n"
         "uniform mat4 model;\n"
-        "uniform mat4 view;\n"
-        "uniform mat4 projection;\n"
         "void main()\n"
         "{\n"
-        "   gl_Position = projection * view * model * vec4(aPos, 1.0);\n"
+        "   gl_Position = viewProjection * model * vec4(aPos, 1.0);\n"
         "   color = aColor;\n"
         "}\0";
     
@@ -27,61 +28,17 @@ GLuint initShader() {
         "   FragColor = vec4(color, 1.0);\n"
         "}\n\0";
 
-    // Compile and link shader program
-    int success;
-    char infoLog[512];
+    // Compile and link shader program, the shader objects are deleted once linked
+    GLuint vertexShader = compileShader(GL_VERTEX_SHADER, vertexShaderSource, "Vertex shader");
+    GLuint fragmentShader = compileShader(GL_FRAGMENT_SHADER, fragmentShaderSource, "Fragment shader");
+    GLuint shaderProgram = linkProgram(vertexShader, fragmentShader, "Shader program");
 
-    // Compile vertex shader
-    GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    /*
-    * glShadersource: loads the GLSL code from the strings into the empty shader objects
-    *
-    * vertexShader: the shader object in which to store the shader
-    * 1: number of strings in the shader source code
-    * vertexShaderSource: an array of pointers to strings containing the source code
-    */
-    glShaderSource(vertexShader, 1, &vertexShaderSource, NULL);
-    glCompileShader(vertexShader);
+    CameraUniforms::bindProgram(shaderProgram);
 
-    /*
-    * glGetshaderiv: retrieves the compile status of the specified shader
-    * (in this case, vertexShader). The GL_COMPILE_STATUS parameter tells the
-    * function to get the compilation status. The result is stored in the success
-    * variable. If the compilation was successful, success will be set to a non-zero
-    * value (usually GL_TRUE), otherwise, it will be set to zero (usually GL_FALSE).
-    *
-    */
-    glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        //retrieves the error log. 512 is the max length of log message stored in infolog
-        glGetShaderInfoLog(vertexShader, 512, NULL, infoLog);
-        std::cout << "Vertex shader compilation failed: " << infoLog << std::endl;
-    }
-
-    // Compile fragment shader
-    GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &fragmentShaderSource, NULL);
-    glCompileShader(fragmentShader);
-    glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        glGetShaderInfoLog(fragmentShader, 512, NULL, infoLog);
-        std::cout << "Fragment shader compilation failed: " << infoLog << std::endl;
-    }
-
-    // Link shader program
-    GLuint shaderProgram = glCreateProgram();
-    glAttachShader(shaderProgram, vertexShader);
-    glAttachShader(shaderProgram, fragmentShader);
-    glLinkProgram(shaderProgram);
-    glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
-    if (!success) {
-        glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
-        std::cout << "Shader program linking failed: " << infoLog << std::endl;
-    }
-
-    // Clean up shader objects
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
+    // The model matrix is identity unless a draw sets its own, and the render backend restores it
+    const float identity[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+    glUseProgram(shaderProgram);
+    glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "model"), 1, GL_FALSE, identity);
 
     return shaderProgram;
 }
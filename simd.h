@@ -0,0 +1,10 @@
+#pragma once
+
+// SSE2 is part of every x86-64 target, MSVC only defines _M_X64 / _M_IX86_FP instead of __SSE2__.
+// Kernels check BSP_SIMD_SSE2 and keep a scalar path that gives the same results everywhere else.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BSP_SIMD_SSE2 1
+#include <emmintrin.h>
+#else
+#define BSP_SIMD_SSE2 0
+#endif
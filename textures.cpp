@@ -3,7 +3,7 @@
 
 namespace BSP {
 	void Textures::displayData() const {
-		for (const auto& texture : elements) {
+		for (const auto& texture : getData()) {
 			std::cout << texture.name << std::endl;
 			std::cout << texture.flags << std::endl;
 			std::cout << texture.textureType << std::endl;
@@ -11,7 +11,7 @@ namespace BSP {
 	}
 
 	void Textures::validate() {
-		for (const auto& texture : elements) {
+		for (const auto& texture : getData()) {
 			// Verificar se o nome da textura  vlido (no vazio, por exemplo)
 			warning_assert(texture.name[0] != '\0', "Texture name is empty.");
 
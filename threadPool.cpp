@@ -0,0 +1,129 @@
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+
+#include "threadPool.h"
+
+ThreadPool::ThreadPool(unsigned int threadCount) {
+    // hardware_concurrency() may return 0 when it can't tell
+    threadCount = std::max(1u, threadCount);
+
+    workers.reserve(threadCount);
+    for (unsigned int i = 0; i < threadCount; i++) {
+        workers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        stopping = true;
+    }
+    queueCondition.notify_all();
+
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+std::future<void> ThreadPool::submit(std::function<void()> task) {
+    std::packaged_task<void()> packagedTask(std::move(task));
+    std::future<void> result = packagedTask.get_future();
+
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        tasks.push(std::move(packagedTask));
+    }
+    queueCondition.notify_one();
+
+    return result;
+}
+
+void ThreadPool::parallelFor(int count, const std::function<void(int)>& task) {
+    if (count <= 0) {
+        return;
+    }
+
+    // Shared between the caller and the helpers, helpers may start after the caller returned
+    struct Work {
+        std::atomic<int> next{ 0 };
+        std::atomic<bool> failed{ false };
+        int finished = 0;
+        std::exception_ptr error;   // First exception thrown by task, guarded by mutex
+        std::mutex mutex;
+        std::condition_variable done;
+    };
+    auto work = std::make_shared<Work>();
+
+    // Exceptions never leave run(), every item has to be counted or the caller would wait forever.
+    // Once one item threw, the items left are counted without running them.
+    auto run = [work, count, &task]() {
+        int finishedHere = 0;
+        for (int i = work->next++; i < count; i = work->next++) {
+            if (!work->failed) {
+                try {
+                    task(i);
+                }
+                catch (...) {
+                    std::lock_guard<std::mutex> lock(work->mutex);
+                    if (!work->error) {
+                        work->error = std::current_exception();
+                    }
+                    work->failed = true;
+                }
+            }
+            finishedHere++;
+        }
+
+        if (finishedHere > 0) {
+            std::lock_guard<std::mutex> lock(work->mutex);
+            work->finished += finishedHere;
+            if (work->finished == count) {
+                work->done.notify_all();
+            }
+        }
+    };
+
+    // The caller takes one share of the work itself
+    int helpers = std::min(count, static_cast<int>(workers.size()) + 1) - 1;
+    for (int i = 0; i < helpers; i++) {
+        // Helpers only touch task while items are left, and the caller waits for every item
+        submit(run);
+    }
+
+    run();
+
+    std::unique_lock<std::mutex> lock(work->mutex);
+    work->done.wait(lock, [&work, count]() { return work->finished == count; });
+
+    // Rethrown on the calling thread once no helper can touch task anymore
+    if (work->error) {
+        std::rethrow_exception(work->error);
+    }
+}
+
+ThreadPool& ThreadPool::shared() {
+    static ThreadPool pool;
+    return pool;
+}
+
+void ThreadPool::workerLoop() {
+    for (;;) {
+        std::packaged_task<void()> task;
+
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            queueCondition.wait(lock, [this]() { return stopping || !tasks.empty(); });
+
+            if (stopping && tasks.empty()) {
+                return;
+            }
+
+            task = std::move(tasks.front());
+            tasks.pop();
+        }
+
+        task();
+    }
+}
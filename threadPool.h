@@ -0,0 +1,42 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads fed from a single task queue.
+// Used by the loader to spread independent CPU work (lump decoding, tessellation) across cores.
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned int threadCount = std::thread::hardware_concurrency());
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Queue a task, the future becomes ready once it has run
+    std::future<void> submit(std::function<void()> task);
+
+    // Run task(0) .. task(count - 1) on the pool and on the calling thread, returns when all are done.
+    // The calling thread keeps taking work, so this is safe to call from inside a pool task.
+    // If task throws, the items not started yet are skipped and the first exception is rethrown here.
+    void parallelFor(int count, const std::function<void(int)>& task);
+
+    unsigned int size() const { return static_cast<unsigned int>(workers.size()); }
+
+    // Process-wide pool sized to the number of hardware threads
+    static ThreadPool& shared();
+
+private:
+    std::vector<std::thread> workers;
+    std::queue<std::packaged_task<void()>> tasks;
+    std::mutex queueMutex;
+    std::condition_variable queueCondition;
+    bool stopping = false;
+
+    void workerLoop();
+};
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+
+#include "simd.h"
+
+/*
+Quake III stores positions and directions Z-up, the engine is Y-up. Every spatial lump is converted
+while its records are copied out of the file: (x, y, z) becomes (x, z, -y). Bounding boxes also
+swap which side is the minimum on the negated axis, so min stays below max.
+
+The helpers work on a record that is already at its destination. The "Wide" versions move 16 bytes
+with SSE2 shuffles and write the 4 bytes after the 3 values back unchanged, so they are only used
+when those 4 bytes are still inside the buffer.
+*/
+
+namespace BSP {
+    namespace Transcode {
+        inline void vector(float* v) {
+            float y = v[1];
+            v[1] = v[2];
+            v[2] = -y;
+        }
+
+        template <typename T>
+        inline void box(T* min, T* max) {
+            T minY = min[1];
+            T maxY = max[1];
+            min[1] = min[2];
+            max[1] = max[2];
+            min[2] = -maxY;
+            max[2] = -minY;
+        }
+
+#if BSP_SIMD_SSE2
+        // Flip the sign of lane 2 of a float vector
+        inline __m128 negateZ(__m128 v) {
+            return _mm_xor_ps(v, _mm_castsi128_ps(_mm_setr_epi32(0, 0, static_cast<int>(0x80000000u), 0)));
+        }
+
+        // Negate lane 2 of an int vector
+        inline __m128i negateZ(__m128i v) {
+            const __m128i laneZ = _mm_setr_epi32(0, 0, -1, 0);
+            __m128i negated = _mm_sub_epi32(_mm_setzero_si128(), v);
+            return _mm_or_si128(_mm_andnot_si128(laneZ, v), _mm_and_si128(laneZ, negated));
+        }
+
+        inline void vectorWide(float* v) {
+            __m128 value = _mm_loadu_ps(v);
+            _mm_storeu_ps(v, negateZ(_mm_shuffle_ps(value, value, _MM_SHUFFLE(3, 1, 2, 0))));
+        }
+
+        // (min.x, min.z, -max.y) and (max.x, max.z, -min.y), lane 3 keeps what was there.
+        // Both sides are loaded before anything is stored, so the two may overlap.
+        inline void boxLanes(__m128 min, __m128 max, __m128& newMin, __m128& newMax) {
+            __m128 maxYMinW = _mm_shuffle_ps(max, min, _MM_SHUFFLE(3, 3, 1, 1));
+            __m128 minYMaxW = _mm_shuffle_ps(min, max, _MM_SHUFFLE(3, 3, 1, 1));
+            newMin = _mm_shuffle_ps(min, maxYMinW, _MM_SHUFFLE(2, 0, 2, 0));
+            newMax = _mm_shuffle_ps(max, minYMaxW, _MM_SHUFFLE(2, 0, 2, 0));
+        }
+
+        inline void boxWide(float* min, float* max) {
+            __m128 newMin, newMax;
+            boxLanes(_mm_loadu_ps(min), _mm_loadu_ps(max), newMin, newMax);
+            _mm_storeu_ps(min, negateZ(newMin));
+            _mm_storeu_ps(max, negateZ(newMax));
+        }
+
+        inline void boxWide(int* min, int* max) {
+            __m128 newMin, newMax;
+            boxLanes(_mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(min))),
+                _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(max))), newMin, newMax);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(min), negateZ(_mm_castps_si128(newMin)));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(max), negateZ(_mm_castps_si128(newMax)));
+        }
+#else
+        inline void vectorWide(float* v) { vector(v); }
+        inline void boxWide(float* min, float* max) { box(min, max); }
+        inline void boxWide(int* min, int* max) { box(min, max); }
+#endif
+
+        // Copy every record to destination (skipped when converting in place) and convert it right away,
+        // while it is still in cache. convert(record, hasNext) may use the wide helpers on the last
+        // field of a record only when hasNext is true.
+        template <typename T, typename Convert>
+        void records(const T* source, T* destination, size_t count, Convert convert) {
+            for (size_t i = 0; i < count; i++) {
+                if (source != destination) {
+                    std::memcpy(&destination[i], &source[i], sizeof(T));
+                }
+                convert(destination[i], i + 1 < count);
+            }
+        }
+    }
+}
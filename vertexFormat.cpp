@@ -0,0 +1,175 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "vertexFormat.h"
+
+namespace BSP {
+    int VertexFormat::stride() const {
+        int bytes = 3 * sizeof(float);
+        bytes += packedColor ? 4 : 4 * sizeof(float);
+        bytes += 2 * (halfTexCoords ? 2 * sizeof(uint16_t) : 2 * sizeof(float));
+        bytes += octahedralNormals ? 2 * sizeof(int16_t) : 3 * sizeof(float);
+        return bytes;
+    }
+
+    int VertexFormat::id() const {
+        // Bit 3 marks the layouts with every attribute (the first cooked format was pos + float color)
+        return 8 | (packedColor ? 1 : 0) | (halfTexCoords ? 2 : 0) | (octahedralNormals ? 4 : 0);
+    }
+
+    void VertexFormat::setupAttributes() const {
+        GLsizei bytes = stride();
+        size_t offset = 0;
+
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, bytes, (void*)offset);
+        glEnableVertexAttribArray(0);
+        offset += 3 * sizeof(float);
+
+        if (packedColor) {
+            glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, bytes, (void*)offset);
+            offset += 4;
+        }
+        else {
+            glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, bytes, (void*)offset);
+            offset += 4 * sizeof(float);
+        }
+        glEnableVertexAttribArray(1);
+
+        for (GLuint location = 2; location <= 3; location++) {
+            if (halfTexCoords) {
+                glVertexAttribPointer(location, 2, GL_HALF_FLOAT, GL_FALSE, bytes, (void*)offset);
+                offset += 2 * sizeof(uint16_t);
+            }
+            else {
+                glVertexAttribPointer(location, 2, GL_FLOAT, GL_FALSE, bytes, (void*)offset);
+                offset += 2 * sizeof(float);
+            }
+            glEnableVertexAttribArray(location);
+        }
+
+        if (octahedralNormals) {
+            glVertexAttribPointer(4, 2, GL_SHORT, GL_TRUE, bytes, (void*)offset);
+        }
+        else {
+            glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, bytes, (void*)offset);
+        }
+        glEnableVertexAttribArray(4);
+    }
+
+    template <typename T>
+    static unsigned char* put(unsigned char* out, const T& value) {
+        std::memcpy(out, &value, sizeof(T));
+        return out + sizeof(T);
+    }
+
+    void VertexFormat::write(const Vertex& vertex, unsigned char* out) const {
+        Vec3f position = vertex.getPosition();
+        Vec2f textureCoord = vertex.getTextureCoord();
+        Vec2f lightmapCoord = vertex.getLightmapCoord();
+        Vec3f normal = vertex.getNormal();
+
+        // The lump stores the color as 4 unsigned bytes
+        write(&position[0], vertex.getColor(), &textureCoord[0], &lightmapCoord[0], &normal[0], out);
+    }
+
+    void VertexFormat::write(const float position[3], const unsigned char color[4], const float textureCoord[2],
+        const float lightmapCoord[2], const float normal[3], unsigned char* out) const {
+        for (int i = 0; i < 3; i++) {
+            out = put(out, position[i]);
+        }
+
+        for (int i = 0; i < 4; i++) {
+            if (packedColor) {
+                *out++ = color[i];
+            }
+            else {
+                out = put(out, color[i] / 255.0f);
+            }
+        }
+
+        const float* coords[2] = { textureCoord, lightmapCoord };
+        for (const float* coord : coords) {
+            for (int i = 0; i < 2; i++) {
+                if (halfTexCoords) {
+                    out = put(out, floatToHalf(coord[i]));
+                }
+                else {
+                    out = put(out, coord[i]);
+                }
+            }
+        }
+
+        if (octahedralNormals) {
+            int16_t encoded[2];
+            encodeOctahedral(Vec3f(normal[0], normal[1], normal[2]), encoded);
+            out = put(out, encoded[0]);
+            put(out, encoded[1]);
+        }
+        else {
+            for (int i = 0; i < 3; i++) {
+                out = put(out, normal[i]);
+            }
+        }
+    }
+
+    uint16_t floatToHalf(float value) {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+
+        uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+        uint32_t exponent = (bits >> 23) & 0xFF;
+        uint32_t mantissa = bits & 0x7FFFFF;
+
+        // NaN stays NaN, infinity and overflow become infinity
+        if (exponent == 0xFF) {
+            return sign | 0x7C00 | (mantissa ? 0x200 : 0);
+        }
+
+        int halfExponent = static_cast<int>(exponent) - 127 + 15;
+        if (halfExponent >= 31) {
+            return sign | 0x7C00;
+        }
+
+        if (halfExponent <= 0) {
+            // Subnormal half, or zero when too small
+            if (halfExponent < -10) {
+                return sign;
+            }
+            mantissa |= 0x800000;
+            int shift = 14 - halfExponent;
+            uint32_t half = mantissa >> shift;
+            uint32_t remainder = mantissa & ((1u << shift) - 1);
+            uint32_t halfway = 1u << (shift - 1);
+            if (remainder > halfway || (remainder == halfway && (half & 1))) {
+                half++;
+            }
+            return sign | static_cast<uint16_t>(half);
+        }
+
+        uint32_t half = (static_cast<uint32_t>(halfExponent) << 10) | (mantissa >> 13);
+        uint32_t remainder = mantissa & 0x1FFF;
+        if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1))) {
+            // May carry into the exponent, which also rounds up to infinity correctly
+            half++;
+        }
+        return sign | static_cast<uint16_t>(half);
+    }
+
+    void encodeOctahedral(const Vec3f& normal, int16_t out[2]) {
+        float sum = std::fabs(normal.x()) + std::fabs(normal.y()) + std::fabs(normal.z());
+        float x = sum > 0.0f ? normal.x() / sum : 0.0f;
+        float y = sum > 0.0f ? normal.y() / sum : 0.0f;
+
+        // Fold the lower hemisphere over the diagonals
+        if (normal.z() < 0.0f) {
+            float foldedX = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+            float foldedY = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+            x = foldedX;
+            y = foldedY;
+        }
+
+        out[0] = static_cast<int16_t>(std::lround(std::max(-1.0f, std::min(1.0f, x)) * 32767.0f));
+        out[1] = static_cast<int16_t>(std::lround(std::max(-1.0f, std::min(1.0f, y)) * 32767.0f));
+    }
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+
+#include "GL_Utils.h"
+#include "vertices.h"
+
+namespace BSP {
+    /*
+    Layout of the vertices in the face and patch VBOs. Every attribute of BSP::Vertex is kept:
+
+    location 0: position        3 floats
+    location 1: color           4 unsigned bytes (normalized) or 4 floats
+    location 2: texture coord   2 half floats or 2 floats
+    location 3: lightmap coord  2 half floats or 2 floats
+    location 4: normal          2 normalized shorts (octahedral) or 3 floats
+
+    The packed layout (the default) is 28 bytes per vertex, the full float one 56. Octahedral normals
+    are decoded in the shader with:
+
+        vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+        if (n.z < 0.0) n.xy = (1.0 - abs(n.yx)) * sign(n.xy);
+        n = normalize(n);
+    */
+    struct VertexFormat {
+        bool packedColor = true;        // Unsigned bytes instead of floats
+        bool halfTexCoords = true;      // Half floats instead of floats, for both UV sets
+        bool octahedralNormals = true;  // Two normalized shorts instead of three floats
+
+        // Bytes per vertex
+        int stride() const;
+
+        // Unique per layout, part of the cooked cache key
+        int id() const;
+
+        // Set the attribute pointers of the bound VAO for the bound GL_ARRAY_BUFFER
+        void setupAttributes() const;
+
+        // Encode one vertex into stride() bytes
+        void write(const Vertex& vertex, unsigned char* out) const;
+
+        // Same from the attributes themselves, for vertices that are not stored as a Vertex
+        void write(const float position[3], const unsigned char color[4], const float textureCoord[2],
+            const float lightmapCoord[2], const float normal[3], unsigned char* out) const;
+    };
+
+    // IEEE half float, round to nearest even, overflow becomes infinity
+    uint16_t floatToHalf(float value);
+
+    // Unit vector to octahedral coordinates in [-1, 1], as two normalized shorts
+    void encodeOctahedral(const Vec3f& normal, int16_t out[2]);
+}
@@ -1,4 +1,5 @@
 #include "vertices.h"
+#include "transcode.h"
 
 namespace BSP {
 	std::ostream& operator<<(std::ostream& os, const Vertex& vertex) {
@@ -11,24 +12,13 @@ namespace BSP {
 		return os;
 	}
 
-	void Vertices::load(std::ifstream& file, LumpData& lumpData) {
-		Element::load(file, lumpData);
-		updateYAndZ();
-	}
-
-	// Swap the y and z values, and negate the new z so Y is up 
-	// the swapping of y and z values and negating the new z value is related 
-	// to the differences in coordinate systems used in the Quake 3 engine and 
-	// most 3D modeling software
-	void Vertices::updateYAndZ() {
-		for (auto& vertex : elements) {
-			Vec3<float> newPosition = vertex.getPosition();
-
-			newPosition.y() = vertex.getPosition().z(); // Access z using () instead of .z
-			newPosition.z() = -vertex.getPosition().y(); // Access y using () instead of .y
-
-			vertex.setPosition(newPosition);
-		}
+	// Position and normal go from Quake's Z-up to Y-up. The normal is followed by the 4 color
+	// bytes, so both fields can always use the wide helpers.
+	void Vertices::transcode(const Vertex* source, Vertex* destination, size_t count) {
+		Transcode::records(source, destination, count, [](Vertex& vertex, bool) {
+			Transcode::vectorWide(&vertex.position[0]);
+			Transcode::vectorWide(&vertex.normal[0]);
+		});
 	}
 
 	void Vertices::displayData() const {
@@ -4,6 +4,7 @@
 #include "vector.h"
 #include "utils.h"
 
+#include <algorithm>
 #include <iostream>
 
 namespace BSP {
@@ -15,7 +16,7 @@ namespace BSP {
         Vec2f getTextureCoord() const { return textureCoord; }
         Vec2f getLightmapCoord() const { return lightmapCoord; }
         Vec3f getNormal() const { return normal; }
-        const char* getColor() const { return color; }
+        const unsigned char* getColor() const { return color; }
 
         // Mutator (setter) methods
         void setPosition(const Vec3f& newPosition) { position = newPosition; }
@@ -23,10 +24,11 @@ namespace BSP {
         void setLightmapCoord(const Vec2f& newLightmapCoord) { lightmapCoord = newLightmapCoord; }
         void setNormal(const Vec3f& newNormal) { normal = newNormal; }
 
-        //TODO: tirar esse char[4] daqui
+        // Components in [0, 255], rounded and clamped
         void setColor(const Vec4f& newColor) {
             for (int i = 0; i < 4; ++i) {
-                color[i] = static_cast<char>(newColor[i]);
+                float component = std::min(255.0f, std::max(0.0f, newColor[i]));
+                color[i] = static_cast<unsigned char>(component + 0.5f);
             }
         }
 
@@ -34,20 +36,24 @@ namespace BSP {
         ~Vertex() = default;
 
     private:
+        friend class Vertices;
+
         Vec3f position;         // (x, y, z) position. 
         Vec2f textureCoord;     // (u, v) texture coordinate
         Vec2f lightmapCoord;    // (u, v) lightmap coordinate
         Vec3f normal;           // (x, y, z) normal vector
-        char color[4];          // RGBA color for the vertex
+        unsigned char color[4]; // RGBA color for the vertex
     };
 
     std::ostream& operator<<(std::ostream& os, const Vertex& vertex);
 
     class Vertices : public BSP::Element<Vertex> {
     public:
-        void load(std::ifstream& file, LumpData& lumpData) override;
         void validate() override;
         void displayData() const override;
-        void updateYAndZ();
+
+    protected:
+        bool isTranscoded() const override { return true; }
+        void transcode(const Vertex* source, Vertex* destination, size_t count) override;
     };
 }
\ No newline at end of file